@@ -27,17 +27,6 @@ IPAddress ip(192, 168, 188, 111);
 #define Z21_UDP_TX_MAX_SIZE 15  //--> POM DATA has 12 Byte!
 unsigned char packetBuffer[Z21_UDP_TX_MAX_SIZE]; //buffer to hold incoming packet,
 
-#define maxIP 20  //Größe des IP-Speicher
-typedef struct		//Rückmeldung des Status der Programmierung
-{
-  byte IP0;
-  byte IP1;
-  byte IP2;
-  byte IP3;
-} listofIP;
-listofIP mem[maxIP];
-byte storedIP = 0;  //speicher für IPs
-
 /*********************************************************************************************/
 // the setup routine runs once when you press reset:
 void setup() {                
@@ -59,8 +48,9 @@ void loop() {
   //--------------------------------------------------------------------------------------------
   if(Udp.parsePacket() > 0) {  //packetSize
     Udp.read(packetBuffer,Z21_UDP_TX_MAX_SIZE);  // read the packet into packetBufffer
-    IPAddress remote = Udp.remoteIP();
-    z21.receive(addIP(remote[0], remote[1], remote[2], remote[3]), packetBuffer);
+    byte client = z21.getClient(Udp.remoteIP(), Udp.remotePort());  //IP and Port of the client
+    if (client > 0)
+      z21.receive(client, packetBuffer);
   }
   
    //-------------------------------------------------------------------------------------------- 
@@ -73,20 +63,14 @@ void loop() {
 }
 
 //--------------------------------------------------------------------------------------------
-byte addIP (byte ip0, byte ip1, byte ip2, byte ip3) {
-  //suche ob IP schon vorhanden?
-  for (byte i = 0; i < storedIP; i++) {
-    if (mem[i].IP0 == ip0 && mem[i].IP1 == ip1 && mem[i].IP2 == ip2 && mem[i].IP3 == ip3)
-      return i+1;
+void sendUdp (byte client, uint8_t *data, uint16_t length) {
+  uint32_t ip;
+  uint16_t port;
+  if (z21.getEndpoint(client, ip, port)) {
+    Udp.beginPacket(IPAddress(ip), port);
+    Udp.write(data, length);
+    Udp.endPacket();
   }
-  if (storedIP >= maxIP)
-    return 0;
-  mem[storedIP].IP0 = ip0;
-  mem[storedIP].IP1 = ip1;
-  mem[storedIP].IP2 = ip2;
-  mem[storedIP].IP3 = ip3;
-  storedIP++;
-  return storedIP;  
 }
 
 //--------------------------------------------------------------------------------------------
@@ -100,19 +84,17 @@ void notifyz21RailPower(uint8_t State)
 void notifyz21EthSend(uint8_t client, uint8_t *data) 
 {
   if (client == 0) { //all stored 
-    for (byte i = 0; i < storedIP; i++) {
-      IPAddress ip(mem[i].IP0, mem[i].IP1, mem[i].IP2, mem[i].IP3);
-      Udp.beginPacket(ip, Udp.remotePort());    //Broadcast
-      Udp.write(data, data[0]);
-      Udp.endPacket();
-    }
-  }
-  else {
-    IPAddress ip(mem[client-1].IP0, mem[client-1].IP1, mem[client-1].IP2, mem[client-1].IP3);
-    Udp.beginPacket(ip, Udp.remotePort());    //no Broadcast
-    Udp.write(data, data[0]);
-    Udp.endPacket();
+    for (byte i = 1; i <= z21clientMAX; i++)
+      sendUdp(i, data, data[0]);    //Broadcast
   }
+  else sendUdp(client, data, data[0]);    //no Broadcast
+}
+
+//--------------------------------------------------------------------------------------------
+void notifyz21EthSendDatagram(uint8_t client, uint8_t *data, uint16_t length)
+{
+  //more then one Z21 message inside one UDP packet
+  sendUdp(client, data, length);
 }
 
 //--------------------------------------------------------------------------------------------
@@ -0,0 +1,82 @@
+/*
+  Arduino.h - minimal Arduino API to build the Z21 library on a host PC
+  Copyright (c) 2026 Philipp Gahtow  All right reserved.
+
+  Notice:
+	- only for the tools in extras (z21replay), not for a board!
+	- millis() and micros() read the virtual clock z21HostTime,
+	  the tool set the time of each message before it call receive()
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HEX 16
+#define DEC 10
+#define BIN 2
+
+#define lowByte(w) ((uint8_t) ((w) & 0xff))
+#define highByte(w) ((uint8_t) ((w) >> 8))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+
+inline uint16_t word(uint8_t h, uint8_t l) { return (h << 8) | l; }
+
+//virtual clock in micro seconds:
+extern uint32_t z21HostTime;
+inline unsigned long micros() { return __atomic_load_n(&z21HostTime, __ATOMIC_RELAXED); }	//also from threads (z21shard.h)
+inline unsigned long millis() { return micros() / 1000; }
+
+//--------------------------------------------------------------------------------------------
+class Print
+{
+  public:
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size) {
+		size_t n = 0;
+		while (size--)
+			n += write(*buffer++);
+		return n;
+	}
+	size_t print(const char *s) { return write((const uint8_t *) s, strlen(s)); }
+	size_t print(char c) { return write((uint8_t) c); }
+	size_t print(unsigned long n, int base = DEC) {
+		char buf[12];
+		snprintf(buf, sizeof(buf), base == HEX ? "%lX" : "%lu", n);
+		return print(buf);
+	}
+	size_t print(long n, int base = DEC) {
+		if (base == DEC && n < 0)
+			return print('-') + print((unsigned long) -n);
+		return print((unsigned long) n, base);
+	}
+	size_t print(unsigned int n, int base = DEC) { return print((unsigned long) n, base); }
+	size_t print(int n, int base = DEC) { return print((long) n, base); }
+	size_t print(unsigned char n, int base = DEC) { return print((unsigned long) n, base); }
+	size_t println(void) { return print("\r\n"); }
+	template <class T> size_t println(T v) { return print(v) + println(); }
+	template <class T> size_t println(T v, int base) { return print(v, base) + println(); }
+};
+
+//stdout:
+class HardwareSerial : public Print
+{
+  public:
+	void begin(unsigned long baud) {}
+	virtual size_t write(uint8_t c) { return fputc(c, stdout) == EOF ? 0 : 1; }
+	using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif
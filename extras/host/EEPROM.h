@@ -0,0 +1,24 @@
+/*
+  EEPROM.h - EEPROM in RAM to build the Z21 library on a host PC
+  Copyright (c) 2026 Philipp Gahtow  All right reserved.
+*/
+
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#define z21HostEEPROMSize 1024
+
+class EEPROMClass
+{
+  public:
+	EEPROMClass(void) { memset(data, 0xFF, sizeof(data)); }	//like a new chip
+	uint8_t read(int idx) { return data[idx % z21HostEEPROMSize]; }
+	void write(int idx, uint8_t val) { data[idx % z21HostEEPROMSize] = val; }
+	void update(int idx, uint8_t val) { write(idx, val); }
+  private:
+	uint8_t data[z21HostEEPROMSize];
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,12 @@
+/*
+  host.cpp - global objects of the Arduino API on a host PC
+  Copyright (c) 2026 Philipp Gahtow  All right reserved.
+*/
+
+#include <Arduino.h>
+#include <EEPROM.h>
+
+uint32_t z21HostTime = 0;
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
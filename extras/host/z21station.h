@@ -0,0 +1,236 @@
+/*
+  z21station.h - virtual command station for the tools in extras (host PC)
+  Copyright (c) 2026 Philipp Gahtow  All right reserved.
+
+  Notice:
+	- backend of the notify hooks: loco state (z21state.h), refresh of the main track (z21refresh.h),
+	  programming track with a virtual decoder
+	- DCC bit timing: "1" = 116 us, "0" = 200 us, preamble 14 bits (main) or 20 bits (programming),
+	  start bit before each byte, end bit; an idle packet if there is nothing to send
+	- programming track (direct mode): power on with 20 reset packets,
+	  read = 8 x (3 reset + 5 verify bit) + 3 reset + 5 verify byte, write = 3 reset + 5 write + 6 reset,
+	  the decoder ACK (6 ms) after the last packet
+	- latency from the hook (time of receive()) until:
+		track		end of the first DCC packet with the new speed on the main track
+		broadcast	LAN_X_LOCO_INFO with the new speed to each client (virtual time, else CPU time)
+		prog		result of the CV read/write (setCVReturn)
+	- call run() after each step of the virtual clock z21HostTime
+	- include after z21.h, build with z21state.cpp z21dcc.cpp z21refresh.cpp
+*/
+
+#ifndef z21station_h
+#define z21station_h
+
+#include <z21refresh.h>
+
+#include <time.h>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+
+#define z21StationBit1 116			//us of a "1"
+#define z21StationBit0 200			//us of a "0"
+#define z21StationPreamble 14		//bits main track
+#define z21StationProgPreamble 20	//bits programming track
+#define z21StationAck 6000			//us decoder ACK
+
+//--------------------------------------------------------------------------------------------
+class z21StationClass
+{
+  public:
+	z21StationClass(void (*result)(uint16_t CV, int value)) : Result(result) { clear(); }
+
+	//new run:
+	void clear() {
+		Refresh.clear();
+		State = z21StateClass();
+		for (unsigned int i = 0; i < 1024; i++)
+			CV[i] = (i * 7 + 3) & 0xFF;		//CV1 = 3
+		Track = z21HostTime;
+		Packets = 0;
+		Idle = 0;
+		Prog = 0;
+		Pending.clear();
+		Seen.clear();
+		TrackLatency.clear();
+		BcLatency.clear();
+		ProgLatency.clear();
+	}
+
+	//--------------------------------------------------------------------------------------------
+	//notify hooks:
+	void locoSpeed(uint16_t Adr, uint8_t speed, uint8_t steps) {
+		State.setLocoSpeed(Adr, speed, steps);
+		Refresh.setSpeed(Adr, speed, steps);
+		TypeZ21StationCmd &c = Pending[Adr];
+		c.len = z21DCCLocoSpeed(c.packet, Adr, speed, steps);
+		c.speed = speed;
+		c.time = z21HostTime;
+		c.ns = nanos();
+		c.onTrack = false;
+		for (std::set<uint32_t>::iterator it = Seen.lower_bound((uint32_t) Adr << 8); it != Seen.end() && (*it >> 8) == Adr; )
+			Seen.erase(it++);	//broadcast again to all clients
+	}
+	void locoFkt(uint16_t Adr, uint8_t type, uint8_t fkt) {
+		if (fkt <= 28)
+			State.setLocoFkt(Adr, type, fkt);
+		Refresh.setFkt(Adr, type, fkt);
+	}
+	void locoFktGroup(uint16_t Adr, uint8_t group, uint8_t fkt) {
+		State.setLocoFktGroup(Adr, group, fkt);
+		Refresh.setFktGroup(Adr, group, fkt);
+	}
+	void locoState(uint16_t Adr, uint8_t data[]) {
+		memset(data, 0, 6);
+		data[0] = DCCSTEP128;
+		State.getLoco(Adr, data);
+	}
+	void cvRead(uint16_t cv) { progStart(cv, -1); }
+	void cvWrite(uint16_t cv, uint8_t value) { progStart(cv, value); }
+
+	//--------------------------------------------------------------------------------------------
+	//sent message of the library (notifyz21EthSend), client 0 = all
+	void ethSend(uint8_t client, uint8_t *data) {
+		if (data[2] != LAN_X_Header || data[4] != LAN_X_LOCO_INFO)
+			return;
+		uint16_t Adr = word(data[5] & 0x3F, data[6]);
+		std::map<uint16_t, TypeZ21StationCmd>::iterator c = Pending.find(Adr);
+		if (c == Pending.end() || data[8] != c->second.speed)
+			return;
+		if (!Seen.insert(((uint32_t) Adr << 8) | client).second)
+			return;	//only the first to each client
+		uint32_t us = z21HostTime - c->second.time;
+		if (us == 0)	//no waiting, CPU time
+			us = (nanos() - c->second.ns) / 1000;
+		BcLatency.push_back(us);
+	}
+
+	//--------------------------------------------------------------------------------------------
+	//send the DCC packets until z21HostTime
+	void run() {
+		while ((int32_t) (z21HostTime - Track) > 0) {
+			byte packet[z21DCCPacketMAX];
+			byte len = Refresh.next(packet);
+			if (len == 0) {		//idle packet
+				packet[0] = 0xFF;
+				packet[1] = 0x00;
+				packet[2] = 0xFF;
+				len = 3;
+				Idle++;
+			}
+			Track += duration(packet, len, z21StationPreamble);
+			Packets++;
+			std::map<uint16_t, TypeZ21StationCmd>::iterator c = Pending.begin();
+			for (; c != Pending.end(); ++c) {
+				if (!c->second.onTrack && c->second.len == len && memcmp(c->second.packet, packet, len) == 0) {
+					c->second.onTrack = true;
+					TrackLatency.push_back(Track - c->second.time);
+					break;
+				}
+			}
+		}
+		if (Prog != 0 && (int32_t) (z21HostTime - ProgDone) >= 0) {	//ACK of the decoder
+			Prog = 0;
+			ProgLatency.push_back(ProgDone - ProgStart);
+			if (ProgValue >= 0)
+				CV[ProgCV] = ProgValue;
+			if (Result)
+				Result(ProgCV, CV[ProgCV]);
+		}
+	}
+
+	//--------------------------------------------------------------------------------------------
+	void report(double seconds) {
+		printf("  track:     %lu packets/s, %.1f%% idle\n", (unsigned long) (Packets / seconds),
+			Packets ? Idle * 100.0 / Packets : 0.0);
+		print("  track us: ", TrackLatency);
+		print("  bc us:    ", BcLatency);
+		print("  prog us:  ", ProgLatency);
+	}
+
+  private:
+	struct TypeZ21StationCmd {
+		byte packet[z21DCCPacketMAX];	//DCC packet of the new speed
+		byte len;
+		byte speed;
+		uint32_t time;		//virtual us of the hook
+		uint64_t ns;		//CPU time of the hook
+		bool onTrack;
+	};
+
+	void (*Result)(uint16_t CV, int value);
+	z21RefreshClass Refresh;
+	z21StateClass State;
+	byte CV[1024];		//virtual decoder on the programming track
+	uint32_t Track;		//virtual us, end of the last packet on the main track
+	unsigned long Packets;
+	unsigned long Idle;
+	byte Prog;			//programming track busy
+	uint16_t ProgCV;
+	int ProgValue;		//-1 = read
+	uint32_t ProgStart;
+	uint32_t ProgDone;	//virtual us of the ACK
+	std::map<uint16_t, TypeZ21StationCmd> Pending;	//last speed of each loco
+	std::set<uint32_t> Seen;	//Adr << 8 | client with the new speed
+	std::vector<uint32_t> TrackLatency;
+	std::vector<uint32_t> BcLatency;
+	std::vector<uint32_t> ProgLatency;
+
+	static uint64_t nanos() {
+		timespec t;
+		clock_gettime(CLOCK_MONOTONIC, &t);
+		return (uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec;
+	}
+
+	//us of one packet with error byte
+	static uint32_t duration(const byte *packet, byte len, byte preamble) {
+		uint32_t us = preamble * z21StationBit1;
+		for (byte i = 0; i < len; i++) {
+			us += z21StationBit0;	//start bit
+			for (byte b = 0; b < 8; b++)
+				us += bitRead(packet[i], b) ? z21StationBit1 : z21StationBit0;
+		}
+		return us + z21StationBit1;		//end bit
+	}
+
+	//service mode packet (direct mode): 0111CCAA AAAAAAAA DDDDDDDD EEEEEEEE
+	static uint32_t service(byte cc, uint16_t cv, byte data, byte count) {
+		byte packet[4] = {(byte) (0x70 | (cc << 2) | ((cv >> 8) & 0x03)), (byte) cv, data, 0};
+		packet[3] = packet[0] ^ packet[1] ^ packet[2];
+		return count * duration(packet, 4, z21StationProgPreamble);
+	}
+
+	static uint32_t reset(byte count) {
+		const byte packet[3] = {0x00, 0x00, 0x00};
+		return count * duration(packet, 3, z21StationProgPreamble);
+	}
+
+	void progStart(uint16_t cv, int value) {
+		ProgCV = cv & 0x3FF;
+		ProgValue = value;
+		ProgStart = z21HostTime;
+		uint32_t us = reset(20);	//power on
+		if (value < 0) {	//read bit by bit, then verify the byte
+			for (byte b = 0; b < 8; b++)
+				us += reset(3) + service(0x02, ProgCV, 0xE8 | b, 5);
+			us += reset(3) + service(0x01, ProgCV, CV[ProgCV], 5);
+		}
+		else us += reset(3) + service(0x03, ProgCV, value, 5) + reset(6);
+		ProgDone = ProgStart + us + z21StationAck;
+		Prog = 1;
+	}
+
+	static void print(const char *name, std::vector<uint32_t> &v) {
+		std::sort(v.begin(), v.end());
+		printf("%s", name);
+		if (v.empty()) {
+			printf("-\n");
+			return;
+		}
+		printf("n %lu  p50 %u  p90 %u  p99 %u  max %u\n", (unsigned long) v.size(),
+			v[(v.size() - 1) * 50 / 100], v[(v.size() - 1) * 90 / 100], v[(v.size() - 1) * 99 / 100], v.back());
+	}
+};
+
+#endif
@@ -0,0 +1,171 @@
+/*
+  z21dccbench.cpp - DCC packets of z21dcc.h on a host PC
+  Copyright (c) 2026 Philipp Gahtow  All right reserved.
+
+  Notice:
+	- print the DCC packets of some known commands and compare them with the bytes of RCN-211/212/213/214,
+	  exit with 1 on a difference
+	- measure the time of each encoder function (ns per packet)
+	- refresh scheduler (z21refresh.h): packets until a burst of new speeds is on the track,
+	  max. packets between two refresh of a moving loco; half of the locos moving, half stopped;
+	  compared with a plain round robin of all packets
+
+  Build (from the library folder):
+	g++ -std=gnu++11 -O2 -DARDUINO=100 -Iextras/host -I. extras/z21dccbench/z21dccbench.cpp extras/host/host.cpp z21dcc.cpp z21refresh.cpp -o z21dccbench
+
+  Usage:
+	z21dccbench [count]
+		count	packets for each function (default: 10000000)
+*/
+
+#include <Arduino.h>
+#include <z21dcc.h>
+#include <z21refresh.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//--------------------------------------------------------------------------------------------
+static uint64_t hostNanos() {
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+//print the packet and compare with the expected bytes ("" = no packet)
+static unsigned int Errors;
+
+static void checkPacket(const char *name, byte *packet, byte len, const char *expect) {
+	char text[3 * z21DCCPacketMAX + 1] = "";
+	for (byte i = 0; i < len; i++)
+		sprintf(text + (i > 0 ? 3 * i - 1 : 0), i > 0 ? " %02X" : "%02X", packet[i]);
+	printf("%-34s%s", name, len == 0 ? "-" : text);
+	if (strcmp(text, expect) != 0) {
+		printf("    error: expected %s", expect[0] ? expect : "-");
+		Errors++;
+	}
+	printf("\n");
+}
+
+static volatile byte Sink;	//keep the result
+
+//--------------------------------------------------------------------------------------------
+#define BENCH(name, call) do { \
+	uint64_t t0 = hostNanos(); \
+	for (unsigned long i = 0; i < count; i++) { \
+		Sink ^= call; \
+		Sink ^= packet[0]; \
+	} \
+	printf("%-34s%6.1f ns\n", name, (hostNanos() - t0) / (double) count); \
+} while (0)
+
+static z21RefreshClass Refresh;
+static unsigned long Packets;	//sent to the track
+static unsigned long Last;		//last speed packet of loco 1
+static unsigned long Interval;	//max. packets between two speed packets of loco 1
+
+static byte refreshNext(byte *packet) {
+	byte len = Refresh.next(packet);
+	z21HostTime += 5000;	//~5 ms per packet
+	Packets++;
+	if (len > 0 && packet[0] == 1 && packet[1] == 0x3F) {
+		if (Last > 0 && Packets - Last > Interval)
+			Interval = Packets - Last;
+		Last = Packets;
+	}
+	return len;
+}
+
+//--------------------------------------------------------------------------------------------
+//N locos, change the speed of N/4 locos at once and count the packets until all are sent
+static void benchRefresh(byte N) {
+	Refresh.clear();
+	for (byte i = 1; i <= N; i++) {
+		if (i & 1) {	//moving with light
+			Refresh.setSpeed(i, 0x80 | (10 + i), 128);
+			Refresh.setFkt(i, 1, 0);
+		}
+		else Refresh.setSpeed(i, 0, 128);	//stopped
+	}
+	byte packet[z21DCCPacketMAX];
+	for (unsigned int i = 0; i < 2000; i++)	//all changes sent, stopped locos decayed
+		refreshNext(packet);
+	Packets = 0;
+	Last = 0;
+	Interval = 0;
+	unsigned long sum = 0;
+	unsigned long worst = 0;
+	const unsigned int trials = 500;
+	const byte burst = N / 4;
+	for (unsigned int t = 0; t < trials; t++) {
+		byte speed = 0x80 | (1 + t % 100);
+		byte adr = 0;
+		for (byte b = 0; b < burst; b++) {
+			adr = 1 + ((t + b) * 2) % N;	//moving locos
+			Refresh.setSpeed(adr, speed, 128);
+		}
+		unsigned long n = 0;
+		do {
+			n++;
+			if (refreshNext(packet) == 0)
+				continue;
+		} while (packet[0] != adr || packet[1] != 0x3F || packet[2] != speed);	//last of the burst
+		sum += n;
+		if (n > worst)
+			worst = n;
+		for (byte i = 0; i < 20; i++)	//some refresh between the commands
+			refreshNext(packet);
+	}
+	printf("%4d  %5d  %7.1f  %5lu  %7lu  %11d\n", N, burst, sum / (double) trials, worst, Interval, N * 4);
+}
+
+//--------------------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+	unsigned long count = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000UL;
+	byte packet[z21DCCPacketMAX];
+
+	printf("packets:\n");
+	checkPacket("speed 3, 128 steps, forward", packet, z21DCCLocoSpeed(packet, 3, 0x80 | 0x0A, 128), "03 3F 8A B6");
+	checkPacket("speed 3, 28 steps, step 5 (0x04)", packet, z21DCCLocoSpeed(packet, 3, 0x80 | z21DCCSpeedByte(5, 28), 28), "03 64 67");
+	checkPacket("speed 1234, 128 steps, estop", packet, z21DCCLocoSpeed(packet, 1234, 0x01, 128), "C4 D2 3F 01 28");
+	checkPacket("fkt 3, F0 + F1 (group 0x20)", packet, z21DCCLocoFktGroup(packet, 3, 0x20, 0x11), "03 91 92");
+	checkPacket("fkt 1234, F13 - F20 (group 0x23)", packet, z21DCCLocoFktGroup(packet, 1234, 0x23, 0x81), "C4 D2 DE 81 49");
+	checkPacket("accessory 0, output 1, active", packet, z21DCCAccessory(packet, 0, 1, 1), "81 F9 78");
+	checkPacket("accessory 2043, output 0, off", packet, z21DCCAccessory(packet, 2043, 0, 0), "BF 86 39");
+	checkPacket("ext. accessory 4, aspect 5", packet, z21DCCExtAccessory(packet, 4, 5), "81 71 05 F5");
+	checkPacket("POM 3, write CV29 = 6", packet, z21DCCPOMWriteByte(packet, 3, 28, 6), "03 EC 1C 06 F5");
+	checkPacket("POM 1234, write bit CV1.5 = 1", packet, z21DCCPOMWriteBit(packet, 1234, 0, 0x0D), "C4 D2 E8 00 FD 03");
+	checkPacket("POM 3, read CV8", packet, z21DCCPOMReadByte(packet, 3, 7), "03 E4 07 00 E0");
+	checkPacket("POM accessory 0x11, write CV1 = 9", packet, z21DCCPOMAccWriteByte(packet, 0x11, 0, 9), "81 F1 EC 00 09 95");
+	checkPacket("speed 10240 (not valid)", packet, z21DCCLocoSpeed(packet, 10240, 0, 128), "");
+	if (Errors > 0) {
+		printf("\nerror: %u packets\n", Errors);
+		return 1;
+	}
+
+	printf("\nspeed steps (28):\n");
+	for (byte s = 0; s <= 28; s++) {
+		byte v = z21DCCSpeedByte(s, 28);
+		printf("%2d -> 0x%02X -> %d%s", s, v, z21DCCSpeedStep(v, 28), (s % 4) == 3 ? "\n" : "    ");
+		if (z21DCCSpeedStep(v, 28) != s) {
+			printf("\nerror: step %d\n", s);
+			return 1;
+		}
+	}
+
+	printf("\n\ntime (%lu packets):\n", count);
+	BENCH("z21DCCLocoSpeed 128", z21DCCLocoSpeed(packet, 3 + (i & 0x3FF), i, 128));
+	BENCH("z21DCCLocoSpeed 28", z21DCCLocoSpeed(packet, 3 + (i & 0x3FF), i, 28));
+	BENCH("z21DCCLocoFktGroup", z21DCCLocoFktGroup(packet, 3 + (i & 0x3FF), 0x20 + (i & 0x03), i));
+	BENCH("z21DCCAccessory", z21DCCAccessory(packet, i & 0x7FF, i & 1, 1));
+	BENCH("z21DCCExtAccessory", z21DCCExtAccessory(packet, i & 0x7FF, i));
+	BENCH("z21DCCPOMWriteByte", z21DCCPOMWriteByte(packet, 3 + (i & 0x3FF), i & 0x3FF, i));
+	BENCH("z21DCCSpeedStep 28", z21DCCSpeedStep(i, 28));
+
+	printf("\nrefresh (packets):\n");
+	printf("   N  burst  latency  worst  refresh  round robin\n");
+	for (unsigned int N = 8; N <= z21RefreshMAX; N *= 2)
+		benchRefresh(N);
+	return 0;
+}
@@ -0,0 +1,582 @@
+/*
+  z21load.cpp - synthetic load of many Z21 LAN clients on a host PC
+  Copyright (c) 2026 Philipp Gahtow  All right reserved.
+
+  Notice:
+	- simulate N clients inside the same process (no network), 1 ms steps of a virtual clock
+	- profiles of the clients:
+		app		Z21 App: BC-Flag All/RBus/SystemInfo, poll of the system state, slider drags
+		maus	WLANmaus: 0x73 keepalive, turn the knob, functions
+		pc		PC software (Rocrail): BC-Flag NetAll, status poll, automatic drive, turnouts
+		ln		LocoNet listener: BC-Flag LocoNet, status poll
+		mix		50% app, 20% maus, 20% pc, 10% ln
+	- the command station add LocoNet (20/s, not with -DZ21NOLOCONET), S88 (5/s) and system state messages (1/s),
+	  with -DZ21SYSINFO a sample of the current each 10 ms (setSystemInfo), the library send only on a change
+	- report for each N: received and sent messages, datagrams per second,
+	  fan-out (datagrams per received message) and CPU time per received message
+	- a client to all (client 0) count as one datagram for each client, like the example sketches
+	- each 2 s client 1 send LAN_X_SET_STOP: the time until all clients got LAN_X_BC_STOPPED
+	  (virtual time waiting in the send queue + CPU time) is the "stop" column in µs
+	- with -DZ21SENDQUEUE every 10th client is slow: ready only each 20 ms
+	- with -DZ21ACCQUEUE client 1 set a route of 30 turnouts each 5 s: ms until the last coil
+	  is off (getAccSettle) and the max. coils that were on at once
+	- -c: virtual command station (extras/host/z21station.h) behind the hooks, DCC timing of the track,
+	  client 2 read a CV each 2 s on the programming track; report the latency of each N
+	  from the command until the DCC packet is on the track, until LAN_X_LOCO_INFO to the clients,
+	  and of the CV read
+	- -s N (Linux): the same mix with the threaded engine (z21shard.h) and 1, 2, 4 ... N shards,
+	  the first line is one thread with z21Base; report the received messages per second of real time
+	  (all clients, with the time of this simulation), datagrams per received message and the speedup
+	  (no stop latency and route, not with -c)
+
+  Build (from the library folder, the number of clients must be the same for all files):
+	g++ -std=gnu++11 -O2 -pthread -DARDUINO=100 -Dz21clientMAX=255 -Iextras/host -I. extras/z21load/z21load.cpp extras/host/host.cpp z21state.cpp z21dcc.cpp z21refresh.cpp -o z21load
+
+  Usage:
+	z21load [-p app|maus|pc|ln|mix] [-t seconds] [-c] [-s shards] [N ...]
+		default: mix, 10 seconds, N = 1 2 4 8 16 32 64 128 255 (-s: 255)
+*/
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <z21.h>
+#include <z21impl.h>
+#include <z21station.h>
+#if defined(__linux__)
+#include <z21shard.h>
+#endif
+
+#include <stdlib.h>
+#include <time.h>
+
+#define z21LoadApp	0
+#define z21LoadMaus	1
+#define z21LoadPC	2
+#define z21LoadLN	3
+#define z21LoadMix	4
+
+static const char *ProfileName[] = {"app", "maus", "pc", "ln", "mix"};
+
+//--------------------------------------------------------------------------------------------
+//counter of one run
+struct TypeZ21Load {
+	unsigned long rx;		//received messages
+	unsigned long tx;		//sent messages
+	unsigned long datagrams;	//sent UDP datagrams
+	uint64_t busy;			//ns inside the library
+	uint32_t stopTime;		//virtual µs of the last LAN_X_SET_STOP
+	uint64_t stopStart;		//ns of the last LAN_X_SET_STOP
+	unsigned int stopPending;	//clients without LAN_X_BC_STOPPED
+	double stopMax;			//µs until the last client got LAN_X_BC_STOPPED
+	unsigned int coils;		//coils on (Z21ACCQUEUE)
+	unsigned int coilsMax;
+	unsigned long routeMax;	//ms of the slowest route
+};
+
+static TypeZ21Load Load;
+static byte Clients = 0;	//N of this run
+
+static uint64_t hostNanos() {
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+struct z21LoadHandler;
+static z21Base<z21LoadHandler> *z21;
+static z21StationClass *Station = NULL;	//-c
+#if defined(__linux__)
+typedef z21ShardEngine<z21LoadHandler> z21LoadEngine;
+static z21LoadEngine *Engine = NULL;	//-s
+#endif
+
+//Handler without a network, only count
+struct z21LoadHandler : z21NoHandler {
+	static inline void EthSend(uint8_t client, uint8_t *data) {
+		Load.datagrams += (client == 0) ? Clients : 1;	//to all
+		if (Station)
+			Station->ethSend(client, data);
+		if (data[2] == LAN_X_Header && data[4] == LAN_X_BC_STOPPED && Load.stopPending > 0) {
+			Load.stopPending = (client == 0) ? 0 : Load.stopPending - 1;
+			if (Load.stopPending == 0) {
+				double us = z21HostTime - Load.stopTime;
+				if (us == 0)
+					us = (hostNanos() - Load.stopStart) / 1000.0;
+				if (us > Load.stopMax)
+					Load.stopMax = us;
+			}
+		}
+	}
+	static inline bool hasEthSendDatagram() { return true; }
+	static inline void EthSendDatagram(uint8_t client, uint8_t *data, uint16_t length) { Load.datagrams++; }
+	static inline void Capture(uint8_t dir, uint8_t client, uint8_t *data) {
+		if (dir != z21TraceRX)
+			Load.tx++;
+	}
+	static inline bool hasEthReady() { return true; }
+	static inline bool EthReady(uint8_t client) {	//every 10th client is slow
+		return (client % 10 != 3) || ((z21HostTime / 1000) % 20 == 0);
+	}
+	static inline void RailPower(uint8_t State) {
+		#if defined(__linux__)
+		if (Engine) {
+			Engine->setPower(State);
+			return;
+		}
+		#endif
+		z21->setPower(State);
+	}
+	static inline void Accessory(uint16_t Adr, bool state, bool active) {
+		#if defined(__linux__)
+		if (Engine)
+			return;		//Load is not for threads
+		#endif
+		if (!active)
+			Load.coils--;
+		else if (++Load.coils > Load.coilsMax)
+			Load.coilsMax = Load.coils;
+	}
+	static inline void getSystemInfo(uint8_t client) {
+		#if defined(__linux__)
+		if (Engine) {
+			Engine->current().sendSystemInfo(client, 800, 16000, 35);
+			return;
+		}
+		#endif
+		z21->sendSystemInfo(client, 800, 16000, 35);
+	}
+	static inline bool hasLocoState() { return true; }
+	static inline void LocoState(uint16_t Adr, uint8_t data[]) {
+		if (Station)
+			Station->locoState(Adr, data);
+		else {
+			memset(data, 0, 6);
+			data[0] = DCCSTEP128;
+		}
+	}
+	//command station (-c):
+	static inline void LocoSpeed(uint16_t Adr, uint8_t speed, uint8_t steps) { if (Station) Station->locoSpeed(Adr, speed, steps); }
+	static inline void LocoFkt(uint16_t Adr, uint8_t type, uint8_t fkt) { if (Station) Station->locoFkt(Adr, type, fkt); }
+	static inline void LocoFkt0to4(uint16_t Adr, uint8_t fkt) { if (Station) Station->locoFktGroup(Adr, 0x20, fkt); }
+	static inline void LocoFkt5to8(uint16_t Adr, uint8_t fkt) { if (Station) Station->locoFktGroup(Adr, 0x21, fkt); }
+	static inline void LocoFkt9to12(uint16_t Adr, uint8_t fkt) { if (Station) Station->locoFktGroup(Adr, 0x22, fkt); }
+	static inline void LocoFkt13to20(uint16_t Adr, uint8_t fkt) { if (Station) Station->locoFktGroup(Adr, 0x23, fkt); }
+	static inline void LocoFkt21to28(uint16_t Adr, uint8_t fkt) { if (Station) Station->locoFktGroup(Adr, 0x28, fkt); }
+	static inline bool hasCVREAD() { return Station != NULL; }
+	static inline void CVREAD(uint8_t cvAdrMSB, uint8_t cvAdrLSB) { Station->cvRead(word(cvAdrMSB, cvAdrLSB)); }
+	static inline bool hasCVWRITE() { return Station != NULL; }
+	static inline void CVWRITE(uint8_t cvAdrMSB, uint8_t cvAdrLSB, uint8_t value) { Station->cvWrite(word(cvAdrMSB, cvAdrLSB), value); }
+};
+
+//result of the programming track
+static void stationResult(uint16_t CV, int value) {
+	z21->setCVReturn(CV, value);
+}
+
+//--------------------------------------------------------------------------------------------
+//deterministic random numbers
+static uint32_t Seed = 1;
+static uint32_t loadRandom(uint32_t max) {
+	Seed = Seed * 1103515245UL + 12345;
+	return ((Seed >> 16) & 0x7FFF) % max;
+}
+
+//--------------------------------------------------------------------------------------------
+//send one message to the library, XOR at the end for the X-Header
+static void loadSend(byte client, unsigned int header, const byte *data, byte len) {
+	byte packet[24];
+	byte xorbyte = 0;
+	packet[0] = len + 4 + (header == LAN_X_Header);
+	packet[1] = 0;
+	packet[2] = header & 0xFF;
+	packet[3] = header >> 8;
+	for (byte i = 0; i < len; i++) {
+		packet[4 + i] = data[i];
+		xorbyte ^= data[i];
+	}
+	if (header == LAN_X_Header)
+		packet[4 + len] = xorbyte;
+	Load.rx++;
+	#if defined(__linux__)
+	if (Engine) {
+		Engine->receive(client, 21105, packet, packet[0]);	//IP = client
+		return;
+	}
+	#endif
+	uint64_t t0 = hostNanos();
+	z21->receive(client, packet);
+	Load.busy += hostNanos() - t0;
+}
+
+static void loadBCFlags(byte client, unsigned long flags) {
+	byte data[4] = {(byte) flags, (byte) (flags >> 8), (byte) (flags >> 16), (byte) (flags >> 24)};
+	loadSend(client, LAN_SET_BROADCASTFLAGS, data, 4);
+}
+
+static void loadGetStatus(byte client) {
+	byte data[] = {LAN_X_GET_SETTING, 0x24};
+	loadSend(client, LAN_X_Header, data, 2);
+}
+
+static void loadGetLoco(byte client, uint16_t adr) {
+	byte data[] = {LAN_X_GET_LOCO_INFO, 0xF0, (byte) (adr >> 8), (byte) adr};
+	loadSend(client, LAN_X_Header, data, 4);
+}
+
+static void loadDrive(byte client, uint16_t adr, byte speed) {
+	byte data[] = {LAN_X_SET_LOCO, 0x13, (byte) (adr >> 8), (byte) adr, speed};
+	loadSend(client, LAN_X_Header, data, 5);
+}
+
+static void loadFkt(byte client, uint16_t adr, byte fkt) {
+	byte data[] = {LAN_X_SET_LOCO, LAN_X_SET_LOCO_FUNCTION, (byte) (adr >> 8), (byte) adr, (byte) (0x80 | fkt)};	//toggle
+	loadSend(client, LAN_X_Header, data, 5);
+}
+
+static void loadTurnout(byte client, uint16_t adr, bool state) {
+	byte data[] = {LAN_X_SET_TURNOUT, (byte) (adr >> 8), (byte) adr, (byte) (0x88 | state)};	//activate
+	loadSend(client, LAN_X_Header, data, 4);
+	data[3] &= ~0x08;	//deactivate
+	loadSend(client, LAN_X_Header, data, 4);
+}
+
+//--------------------------------------------------------------------------------------------
+//one simulated client
+struct TypeZ21LoadClient {
+	byte id;
+	byte profile;
+	uint16_t loco;
+	byte speed;
+	byte drag;			//steps left of a slider drag or knob turn
+	uint32_t poll;		//ms of the next poll / keepalive
+	uint32_t action;	//ms of the next action
+};
+
+static void clientStart(TypeZ21LoadClient &c) {
+	switch (c.profile) {
+		case z21LoadApp:
+			loadSend(c.id, LAN_GET_SERIAL_NUMBER, NULL, 0);
+			loadBCFlags(c.id, Z21bcAll | Z21bcRBus | Z21bcSystemInfo);
+			loadGetLoco(c.id, c.loco);
+			break;
+		case z21LoadMaus: {
+			byte keep[] = {0x73, 0x00, 0xFF, 0xFF};
+			loadSend(c.id, LAN_X_Header, keep, 4);
+			loadGetLoco(c.id, c.loco);
+			break;
+		}
+		case z21LoadPC:
+			loadBCFlags(c.id, Z21bcAll | Z21bcRBus | Z21bcNetAll);
+			for (byte i = 0; i < 5; i++)
+				loadGetLoco(c.id, c.loco + i);
+			break;
+		case z21LoadLN:
+			loadBCFlags(c.id, Z21bcAll | Z21bcLocoNet | Z21bcLocoNetLocos | Z21bcLocoNetSwitches | Z21bcLocoNetGBM);
+			break;
+	}
+}
+
+static void clientStep(TypeZ21LoadClient &c, uint32_t now) {
+	if (now >= c.poll) {	//poll or keepalive each second
+		c.poll = now + 1000;
+		if (c.profile == z21LoadApp)
+			loadSend(c.id, LAN_SYSTEMSTATE_GETDATA, NULL, 0);
+		else if (c.profile == z21LoadMaus) {
+			byte keep[] = {0x73, 0x00, 0xFF, 0xFF};
+			loadSend(c.id, LAN_X_Header, keep, 4);
+		}
+		else loadGetStatus(c.id);
+	}
+	if (now < c.action)
+		return;
+	switch (c.profile) {
+		case z21LoadApp:	//slider drag: 20 steps each 50 ms, then 2 - 10 s pause
+			if (c.drag == 0)
+				c.drag = 20;
+			c.speed = (c.speed + 3) & 0x7F;
+			loadDrive(c.id, c.loco, c.speed);
+			c.action = now + (--c.drag > 0 ? 50 : 2000 + loadRandom(8000));
+			break;
+		case z21LoadMaus:	//knob: 10 steps each 100 ms, sometimes a function
+			if (c.drag == 0) {
+				c.drag = 10;
+				if (loadRandom(4) == 0)
+					loadFkt(c.id, c.loco, loadRandom(9));
+			}
+			c.speed = (c.speed + 1) & 0x7F;
+			loadDrive(c.id, c.loco, c.speed);
+			c.action = now + (--c.drag > 0 ? 100 : 3000 + loadRandom(10000));
+			break;
+		case z21LoadPC:		//automatic: one of 5 locos each 500 ms, sometimes a turnout
+			loadDrive(c.id, c.loco + loadRandom(5), loadRandom(128));
+			if (loadRandom(4) == 0)
+				loadTurnout(c.id, loadRandom(64), loadRandom(2));
+			c.action = now + 500;
+			break;
+		default:
+			c.action = 0xFFFFFFFF;	//only listen
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//threaded engine (-s): the command station inside shard 0, the sender count the datagrams
+#if defined(__linux__)
+#if !defined(Z21NOLOCONET)
+static void shardLN(z21LoadEngine::Base &z21, const byte *data) { z21.setLNMessage((byte*) data, 4, false); }
+#endif
+static void shardS88(z21LoadEngine::Base &z21, const byte *data) { z21.setS88Data((byte*) data); }
+#if defined(Z21SYSINFO)
+static void shardSystemInfo(z21LoadEngine::Base &z21, const byte *data) { z21.setSystemInfo(word(data[1], data[0]), 16000, 35); }
+#else
+static void shardSystemInfo(z21LoadEngine::Base &z21, const byte *data) { z21.sendSystemInfo(0, word(data[1], data[0]), 16000, 35); }
+#endif
+
+static void shardSend(uint32_t ip, uint16_t port, const uint8_t *data, uint16_t len) {
+	Load.datagrams += (ip == 0) ? Clients : 1;	//to all
+}
+#endif
+
+#if !defined(Z21NOLOCONET)
+static void stationLN(byte *ln) {
+	#if defined(__linux__)
+	if (Engine) {
+		Engine->post(0, shardLN, ln, 4);
+		return;
+	}
+	#endif
+	z21->setLNMessage(ln, 4, false);
+}
+#endif
+
+static void stationS88(byte *s88) {
+	#if defined(__linux__)
+	if (Engine) {
+		Engine->post(0, shardS88, s88, 11);
+		return;
+	}
+	#endif
+	z21->setS88Data(s88);
+}
+
+static void stationSystemInfo(uint16_t current) {
+	#if defined(__linux__)
+	if (Engine) {
+		byte data[] = {(byte) current, (byte) (current >> 8)};
+		Engine->post(0, shardSystemInfo, data, 2);
+		return;
+	}
+	#endif
+	#if defined(Z21SYSINFO)
+	z21->setSystemInfo(current, 16000, 35);
+	#else
+	z21->sendSystemInfo(0, current, 16000, 35);
+	#endif
+}
+
+//--------------------------------------------------------------------------------------------
+//messages of the command station
+static void stationStep(uint32_t now) {
+	uint64_t t0 = hostNanos();
+	#if !defined(Z21NOLOCONET)
+	if (now % 50 == 0) {	//LocoNet: speed of a slot
+		byte ln[] = {0xA0, (byte) (1 + loadRandom(20)), (byte) loadRandom(128), 0};
+		ln[3] = 0xFF ^ ln[0] ^ ln[1] ^ ln[2];
+		stationLN(ln);
+	}
+	#endif
+	if (now % 200 == 0) {	//S88: one group changed
+		byte s88[11];
+		s88[0] = 0;
+		for (byte i = 1; i < 11; i++)
+			s88[i] = loadRandom(256);
+		stationS88(s88);
+	}
+	#if defined(Z21SYSINFO)
+	if (now % 10 == 0)	//samples of the booster, a step each 3 s
+		stationSystemInfo(800 + 200 * ((now / 3000) & 0x01) + loadRandom(100));
+	#else
+	if (now % 1000 == 0)
+		stationSystemInfo(800 + loadRandom(100));
+	#endif
+	if (z21)
+		z21->tick();	//queued messages
+	Load.busy += hostNanos() - t0;
+	if (Station)
+		Station->run();	//DCC of this ms
+	
+	if (now % 2000 == 1007) {	//emergency stop of client 1
+		Load.stopTime = z21HostTime;
+		Load.stopPending = (z21 == NULL) ? 0 : (Clients < z21clientMAX) ? Clients : z21clientMAX;
+		Load.stopStart = hostNanos();
+		byte data[] = {LAN_X_SET_STOP};
+		loadSend(1, LAN_X_Header, data, 1);
+	}
+	if (now % 2000 == 1107) {	//power on again
+		byte data[] = {LAN_X_GET_SETTING, 0x81};
+		loadSend(1, LAN_X_Header, data, 2);
+	}
+	#if defined(Z21ACCQUEUE)
+	if (now % 5000 == 2500 && z21 != NULL) {	//route: 30 turnouts in one burst
+		for (byte i = 0; i < 30; i++) {
+			byte data[] = {LAN_X_SET_TURNOUT, 0x00, (byte) (100 + i), (byte) (0x88 | ((now / 5000 + i) & 0x01))};
+			loadSend(1, LAN_X_Header, data, 4);
+		}
+	}
+	if (now % 5000 == 4999 && z21 != NULL && z21->getAccSettle() > Load.routeMax)
+		Load.routeMax = z21->getAccSettle();
+	#endif
+	if (Station && now % 2000 == 500) {	//read CV1 - CV8
+		byte data[] = {LAN_X_CV_READ, 0x11, 0x00, (byte) ((now / 2000) % 8)};
+		loadSend(Clients > 1 ? 2 : 1, LAN_X_Header, data, 4);
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//clients and command station for the virtual time, return ns of real time
+static uint64_t simulate(byte n, byte profile, uint32_t seconds) {
+	static TypeZ21LoadClient client[255];
+	Seed = 1;
+	memset(&Load, 0, sizeof(Load));
+	z21HostTime = 0;
+	Clients = n;
+	uint64_t start = hostNanos();
+	for (byte i = 0; i < n; i++) {
+		TypeZ21LoadClient &c = client[i];
+		c.id = i + 1;
+		c.profile = profile;
+		if (profile == z21LoadMix) {
+			byte m = i % 10;
+			c.profile = (m < 5) ? z21LoadApp : (m < 7) ? z21LoadMaus : (m < 9) ? z21LoadPC : z21LoadLN;
+		}
+		c.loco = 3 + (i % 40);	//some clients drive the same loco
+		c.speed = 0;
+		c.drag = 0;
+		c.poll = 1000 + loadRandom(1000);
+		c.action = 500 + loadRandom(5000);
+		clientStart(c);
+	}
+	for (uint32_t now = 1; now <= seconds * 1000; now++) {
+		__atomic_store_n(&z21HostTime, now * 1000, __ATOMIC_RELAXED);	//shards read the clock
+		for (byte i = 0; i < n; i++)
+			clientStep(client[i], now);
+		stationStep(now);
+	}
+	#if defined(__linux__)
+	if (Engine)
+		Engine->flush();
+	#endif
+	return hostNanos() - start;
+}
+
+//--------------------------------------------------------------------------------------------
+static void run(byte n, byte profile, uint32_t seconds) {
+	z21 = new z21Base<z21LoadHandler>();
+	z21HostTime = 0;	//start of simulate(), the track of the station begin there
+	if (Station)
+		Station->clear();
+	simulate(n, profile, seconds);
+	printf("%4d  %9.0f  %9.0f  %11.0f  %7.2f  %7.0f  %8.1f\n", n,
+		Load.rx / (double) seconds, Load.tx / (double) seconds, Load.datagrams / (double) seconds,
+		Load.rx ? Load.datagrams / (double) Load.rx : 0.0,
+		Load.rx ? Load.busy / (double) Load.rx : 0.0, Load.stopMax);
+	#if defined(Z21ACCQUEUE)
+	printf("  route:     30 turnouts in %lu ms, max. %u coils on\n", Load.routeMax, Load.coilsMax);
+	#endif
+	if (Station)
+		Station->report(seconds);
+	delete z21;
+	z21 = NULL;
+}
+
+//--------------------------------------------------------------------------------------------
+//-s: one thread, then 1, 2, 4 ... shards
+#if defined(__linux__)
+static void scale(byte n, byte profile, uint32_t seconds, byte shards) {
+	printf("profile %s, %lu s, %d clients, %ld CPUs\n\n", ProfileName[profile], (unsigned long) seconds, n,
+		sysconf(_SC_NPROCESSORS_ONLN));
+	printf("shards       rx/s  datagrams/rx   speedup\n");
+	z21 = new z21Base<z21LoadHandler>();
+	double base = simulate(n, profile, seconds);
+	printf("%6s  %9.0f  %12.2f  %8.2f\n", "-", Load.rx * 1e9 / base, Load.rx ? Load.datagrams / (double) Load.rx : 0.0, 1.0);
+	delete z21;
+	z21 = NULL;
+	for (byte s = 1; s <= shards; s = (s * 2 > shards && s < shards) ? shards : s * 2) {
+		Engine = new z21LoadEngine(s, shardSend);
+		double ns = simulate(n, profile, seconds);
+		printf("%6d  %9.0f  %12.2f  %8.2f", s, Load.rx * 1e9 / ns, Load.rx ? Load.datagrams / (double) Load.rx : 0.0, base / ns);
+		if (Engine->getDropped() > 0)
+			printf("  (%lu frames dropped)", Engine->getDropped());
+		printf("\n");
+		delete Engine;
+		Engine = NULL;
+	}
+}
+#endif
+
+//--------------------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+	byte profile = z21LoadMix;
+	uint32_t seconds = 10;
+	byte list[32];
+	byte count = 0;
+	byte shards = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			i++;
+			for (profile = 0; profile <= z21LoadMix; profile++) {
+				if (strcmp(argv[i], ProfileName[profile]) == 0)
+					break;
+			}
+			if (profile > z21LoadMix) {
+				fprintf(stderr, "unknown profile %s\n", argv[i]);
+				return 2;
+			}
+		}
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			seconds = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-c") == 0)
+			Station = new z21StationClass(stationResult);
+		#if defined(__linux__)
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			int s = atoi(argv[++i]);
+			if (s < 1 || s > z21ShardMAX) {
+				fprintf(stderr, "shards from 1 to %d\n", z21ShardMAX);
+				return 2;
+			}
+			shards = s;
+		}
+		#endif
+		else if (count < sizeof(list)) {
+			int n = atoi(argv[i]);
+			if (n < 1 || n > 255) {
+				fprintf(stderr, "N from 1 to 255\n");
+				return 2;
+			}
+			list[count++] = n;
+		}
+	}
+	#if defined(__linux__)
+	if (shards > 0) {
+		if (Station) {
+			fprintf(stderr, "-s not with -c\n");
+			return 2;
+		}
+		scale(count ? list[0] : 255, profile, seconds, shards);
+		return 0;
+	}
+	#endif
+	if (count == 0) {
+		const byte def[] = {1, 2, 4, 8, 16, 32, 64, 128, 255};
+		memcpy(list, def, sizeof(def));
+		count = sizeof(def);
+	}
+
+	printf("profile %s, %lu s, z21clientMAX %d\n\n", ProfileName[profile], (unsigned long) seconds, z21clientMAX);
+	printf("   N       rx/s       tx/s  datagrams/s   fanout  ns/rx   stop us\n");
+	for (byte i = 0; i < count; i++) {
+		if (list[i] > z21clientMAX)
+			printf("(more clients than z21clientMAX)\n");
+		run(list[i], profile, seconds);
+	}
+	return 0;
+}
@@ -0,0 +1,192 @@
+/*
+  z21replay.cpp - replay a Z21 capture (z21capture.h) on a host PC
+  Copyright (c) 2026 Philipp Gahtow  All right reserved.
+
+  Notice:
+	- feed all received messages of a capture through receive(),
+	  millis() and micros() of the library run on the time of the capture (virtual clock),
+	  tick() is called each time the clock advance
+	- report the throughput, the time of receive() for each message (percentiles)
+	  and the sent messages per header, compared with the sent messages inside the capture
+	- compare two versions of the library with the same capture
+
+  Build (from the library folder, add -DZ21STATE, -DZ21STATS, ... to test a variant):
+	g++ -std=gnu++11 -O2 -DARDUINO=100 -Iextras/host -I. extras/z21replay/z21replay.cpp extras/host/host.cpp z21state.cpp -o z21replay
+
+  Usage:
+	z21replay [-r] capture.bin
+		-r	original speed, wait for the time of the capture (default: maximum speed)
+*/
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <z21.h>
+#include <z21impl.h>
+#include <z21capture.h>
+
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------
+//counter of the sent messages
+struct ReplayCount {
+	unsigned long recorded;	//inside the capture
+	unsigned long replayed;	//sent by this library
+	ReplayCount() : recorded(0), replayed(0) {}
+};
+
+static std::map<uint16_t, ReplayCount> Count;	//Header (X-Header inside the low byte)
+static unsigned long Datagrams = 0;		//EthSend to the sketch
+
+//Header of a message, LAN_X_Header with the X-Header:
+static uint16_t replayKey(const uint8_t *data) {
+	uint16_t header = word(data[3], data[2]);
+	if (header == LAN_X_Header)
+		return (header << 8) | data[4];
+	return header << 8;
+}
+
+//--------------------------------------------------------------------------------------------
+//Handler without a network, only count
+struct z21ReplayHandler : z21NoHandler {
+	static inline void EthSend(uint8_t client, uint8_t *data) { Datagrams++; }
+	static inline void Capture(uint8_t dir, uint8_t client, uint8_t *data) {
+		if (dir != z21TraceRX)
+			Count[replayKey(data)].replayed++;
+	}
+};
+
+static z21Base<z21ReplayHandler> z21;
+
+//--------------------------------------------------------------------------------------------
+static uint64_t hostNanos() {
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+static uint32_t get32(const uint8_t *p) {
+	return p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint32_t percentile(const std::vector<uint32_t> &sorted, unsigned int p) {
+	if (sorted.empty())
+		return 0;
+	return sorted[(sorted.size() - 1) * p / 100];
+}
+
+//--------------------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+	bool realtime = false;
+	const char *name = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-r") == 0)
+			realtime = true;
+		else name = argv[i];
+	}
+	if (name == NULL) {
+		fprintf(stderr, "usage: z21replay [-r] capture.bin\n");
+		return 2;
+	}
+
+	//read the capture:
+	FILE *f = fopen(name, "rb");
+	if (f == NULL) {
+		perror(name);
+		return 1;
+	}
+	std::vector<uint8_t> buf;
+	uint8_t chunk[4096];
+	size_t n;
+	while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+		buf.insert(buf.end(), chunk, chunk + n);
+	fclose(f);
+	if (buf.size() < z21CaptureHeader || memcmp(&buf[0], "Z21C", 4) != 0 || buf[4] != z21CaptureVersion) {
+		fprintf(stderr, "%s: no Z21 capture (version %d)\n", name, z21CaptureVersion);
+		return 1;
+	}
+
+	//replay:
+	std::vector<uint32_t> latency;	//ns of receive() for each message
+	uint64_t busy = 0;		//ns inside receive()
+	uint32_t first = 0;
+	uint32_t last = 0;
+	unsigned long records = 0;
+	uint64_t start = hostNanos();
+	size_t pos = z21CaptureHeader;
+	while (pos + z21CaptureRecord <= buf.size()) {
+		const uint8_t *rec = &buf[pos];
+		uint32_t time = get32(rec);
+		uint8_t client = rec[4];
+		uint8_t dir = rec[5];
+		uint16_t length = word(rec[7], rec[6]);
+		if (length < 4 || pos + z21CaptureRecord + length > buf.size()) {
+			fprintf(stderr, "%s: broken record at %lu\n", name, (unsigned long) pos);
+			break;
+		}
+		uint8_t *data = &buf[pos + z21CaptureRecord];
+		pos += z21CaptureRecord + length;
+		if (records++ == 0)
+			first = time;
+		last = time;
+		if (records == 1 || z21HostTime != time - first) {
+			z21HostTime = time - first;	//virtual clock from the capture
+			if (realtime) {		//wait for the original time
+				uint64_t due = start + (uint64_t) z21HostTime * 1000;
+				uint64_t now = hostNanos();
+				if (due > now) {
+					timespec t;
+					t.tv_sec = (due - now) / 1000000000ULL;
+					t.tv_nsec = (due - now) % 1000000000ULL;
+					nanosleep(&t, NULL);
+				}
+			}
+			z21.tick();	//timeouts, queues and persist at the time of the capture
+		}
+
+		if (dir != z21TraceRX) {
+			Count[replayKey(data)].recorded++;
+			continue;
+		}
+		uint64_t t0 = hostNanos();
+		z21.receive(client, data);
+		uint64_t dt = hostNanos() - t0;
+		busy += dt;
+		latency.push_back(dt > 0xFFFFFFFFULL ? 0xFFFFFFFF : (uint32_t) dt);
+	}
+	uint64_t wall = hostNanos() - start;
+
+	//report:
+	std::vector<uint32_t> sorted(latency);
+	std::sort(sorted.begin(), sorted.end());
+	unsigned long sent = 0;
+	for (std::map<uint16_t, ReplayCount>::iterator it = Count.begin(); it != Count.end(); ++it)
+		sent += it->second.replayed;
+
+	printf("capture:    %s, %lu records, %.3f s\n", name, records, (last - first) / 1e6);
+	printf("mode:       %s\n", realtime ? "original speed" : "maximum speed");
+	printf("received:   %lu messages in %.3f ms (%.3f ms inside receive)\n",
+		(unsigned long) latency.size(), wall / 1e6, busy / 1e6);
+	if (busy > 0)
+		printf("throughput: %.0f messages/s, %.0f sent messages/s\n",
+			latency.size() * 1e9 / busy, sent * 1e9 / busy);
+	printf("latency ns: p50 %u  p90 %u  p99 %u  p99.9 %u  max %u\n",
+		percentile(sorted, 50), percentile(sorted, 90), percentile(sorted, 99),
+		sorted.empty() ? 0 : sorted[(sorted.size() - 1) * 999 / 1000],
+		sorted.empty() ? 0 : sorted.back());
+	printf("sent:       %lu messages, %lu datagrams\n\n", sent, Datagrams);
+
+	printf("header  xheader  recorded  replayed  diff\n");
+	for (std::map<uint16_t, ReplayCount>::iterator it = Count.begin(); it != Count.end(); ++it) {
+		printf("  0x%02X     ", it->first >> 8);
+		if ((it->first >> 8) == LAN_X_Header)
+			printf("0x%02X", it->first & 0xFF);
+		else printf("    ");
+		printf("  %8lu  %8lu  %+ld\n", it->second.recorded, it->second.replayed,
+			(long) it->second.replayed - (long) it->second.recorded);
+	}
+	return 0;
+}
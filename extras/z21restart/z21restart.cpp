@@ -0,0 +1,248 @@
+/*
+  z21restart.cpp - warm restart with the stored state (Z21PERSIST) on a host PC
+  Copyright (c) 2026 Philipp Gahtow  All right reserved.
+
+  Notice:
+	- 8 Z21 Apps (getClient with IP and port) drive 8 locos (a burst of commands each 5 - 15 s),
+	  App 0 switch a turnout each 2 s,
+	  the state is stored by tick() inside a virtual EEPROM (notifyz21PersistWrite/Read)
+	- after a random time the command station restart: new z21Base, begin() (not with -n)
+	- after the restart each App ask for the state of its loco each second (like after a lost connection)
+	- report for each restart:
+		loco ms		time until the first LAN_X_LOCO_INFO with the state before the restart, p50 and max
+		locos		locos with the correct state within 5 s (stopped with the same direction and functions,
+					with -DZ21PERSISTDCC the speed before the restart)
+		clients		Apps 1 - 7 that get the broadcast of App 0 without LAN_SET_BROADCASTFLAGS
+		turnouts	turnouts with the position before the restart
+	- the number of written blocks and bytes (wear of the EEPROM/Flash)
+
+  Build (from the library folder, add -Dz21PersistInterval=250 to compare the time between two writes):
+	g++ -std=gnu++11 -O2 -DARDUINO=100 -DZ21STATE -DZ21PERSIST -Iextras/host -I. extras/z21restart/z21restart.cpp extras/host/host.cpp z21state.cpp -o z21restart
+
+  Usage:
+	z21restart [-n] [restarts]
+		-n	cold restart, don't call begin()
+*/
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <z21.h>
+#include <z21impl.h>
+
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+
+#if !defined(Z21STATE) || !defined(Z21PERSIST)
+#error "build with -DZ21STATE -DZ21PERSIST"
+#endif
+
+#define APPS 8
+#define TRNTS 64
+
+static byte Store[z21PersistSize];	//virtual EEPROM of the sketch
+static unsigned long Writes = 0;
+static unsigned long WriteBytes = 0;
+
+//state before the restart (last LAN_X_LOCO_INFO) and after:
+static byte Truth[APPS][5];		//DB3 - DB7: speed, F0-F4, F5-F12, F13-F20, F21-F28
+static bool TrntTruth[TRNTS];
+static byte Client[APPS];		//client id of each App
+static uint32_t Boot;			//virtual ms of the restart
+static bool Restarted = false;
+static long Correct[APPS];		//ms after the restart with the correct state, -1 = not yet
+static bool BC[APPS];			//broadcast received after the restart
+static uint32_t Next[APPS];		//virtual ms of the next burst
+static byte Burst[APPS];		//commands left of the burst
+
+struct z21RestartHandler;
+static z21Base<z21RestartHandler> *z21;
+
+//--------------------------------------------------------------------------------------------
+struct z21RestartHandler : z21NoHandler {
+	static inline void EthSend(uint8_t client, uint8_t *data) {
+		if (data[2] != LAN_X_Header || data[4] != LAN_X_LOCO_INFO)
+			return;
+		byte app = word(data[5] & 0x3F, data[6]) - 3;	//loco 3 - 10
+		if (app >= APPS)
+			return;
+		if (!Restarted) {
+			memcpy(Truth[app], data + 8, 5);
+			return;
+		}
+		for (byte i = 1; i < APPS; i++) {
+			if (app == 0 && (client == 0 || client == Client[i]))
+				BC[i] = true;
+		}
+		byte expect[5];
+		memcpy(expect, Truth[app], 5);
+		#if !defined(Z21PERSISTDCC)
+		expect[0] &= 0x80;	//begin() stop the locos
+		#endif
+		if ((client == 0 || client == Client[app]) && Correct[app] < 0 && memcmp(expect, data + 8, 5) == 0)
+			Correct[app] = millis() - Boot;
+	}
+	static inline void Accessory(uint16_t Adr, bool state, bool active) {
+		if (active)
+			z21->setTrntInfo(Adr, state);	//position reached
+	}
+	static inline bool hasPersist() { return true; }
+	static inline void PersistWrite(uint16_t pos, uint8_t *data, uint8_t len) {
+		memcpy(Store + pos, data, len);
+		Writes++;
+		WriteBytes += len;
+	}
+	static inline bool PersistRead(uint16_t pos, uint8_t *data, uint8_t len) {
+		memcpy(data, Store + pos, len);
+		return true;
+	}
+};
+
+//--------------------------------------------------------------------------------------------
+static uint32_t Seed = 1;
+static uint32_t restartRandom(uint32_t max) {
+	Seed = Seed * 1103515245UL + 12345;
+	return ((Seed >> 16) & 0x7FFF) % max;
+}
+
+//send from the endpoint of the App
+static void appSend(byte app, unsigned int header, const byte *data, byte len) {
+	byte packet[24];
+	byte xorbyte = 0;
+	packet[0] = len + 4 + (header == LAN_X_Header);
+	packet[1] = 0;
+	packet[2] = header & 0xFF;
+	packet[3] = header >> 8;
+	for (byte i = 0; i < len; i++) {
+		packet[4 + i] = data[i];
+		xorbyte ^= data[i];
+	}
+	if (header == LAN_X_Header)
+		packet[4 + len] = xorbyte;
+	Client[app] = z21->getClient(0xC0A80000UL | (10 + app), 50000 + app);	//192.168.0.10 ...
+	z21->receive(Client[app], packet);
+}
+
+static void step(uint32_t ms) {
+	z21HostTime = ms * 1000;
+	z21->tick();
+}
+
+//--------------------------------------------------------------------------------------------
+//one life of the command station until the restart
+static void run(uint32_t ms, uint32_t until) {
+	for (; ms < until; ms++) {
+		for (byte a = 0; a < APPS; a++) {
+			if (ms < Next[a])
+				continue;
+			if (Burst[a] == 0)
+				Burst[a] = 1 + restartRandom(8);
+			Next[a] = ms + (--Burst[a] > 0 ? 100 : 5000 + restartRandom(10000));
+			uint16_t adr = 3 + a;
+			if (restartRandom(3) == 0) {
+				byte data[] = {LAN_X_SET_LOCO, LAN_X_SET_LOCO_FUNCTION, (byte) (adr >> 8), (byte) adr, (byte) (0x80 | restartRandom(13))};
+				appSend(a, LAN_X_Header, data, 5);
+			}
+			else {
+				byte data[] = {LAN_X_SET_LOCO, 0x13, (byte) (adr >> 8), (byte) adr, (byte) restartRandom(256)};
+				appSend(a, LAN_X_Header, data, 5);
+			}
+		}
+		if (ms % 2000 == 0) {	//App 0 switch a turnout
+			uint16_t adr = restartRandom(TRNTS);
+			bool state = restartRandom(2);
+			byte data[] = {LAN_X_SET_TURNOUT, (byte) (adr >> 8), (byte) adr, (byte) (0x88 | state)};
+			appSend(0, LAN_X_Header, data, 4);
+			TrntTruth[adr] = state;
+		}
+		step(ms);
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+	bool cold = false;
+	unsigned int restarts = 20;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0)
+			cold = true;
+		else restarts = atoi(argv[i]);
+	}
+	memset(Store, 0xFF, sizeof(Store));
+
+	std::vector<uint32_t> time;	//ms until the correct LAN_X_LOCO_INFO
+	unsigned long locos = 0, clients = 0, trnts = 0;
+	uint32_t now = 0;
+	for (unsigned int r = 0; r < restarts; r++) {
+		//start and use the command station:
+		Restarted = false;
+		z21 = new z21Base<z21RestartHandler>();
+		step(now);
+		if (!cold)
+			z21->begin();
+		for (byte a = 0; a < APPS; a++) {
+			unsigned long flags = Z21bcAll | Z21bcRBus;
+			byte data[4] = {(byte) flags, (byte) (flags >> 8), (byte) (flags >> 16), (byte) (flags >> 24)};
+			appSend(a, LAN_SET_BROADCASTFLAGS, data, 4);
+			byte info[] = {LAN_X_GET_LOCO_INFO, 0xF0, 0x00, (byte) (3 + a)};
+			appSend(a, LAN_X_Header, info, 4);
+		}
+		for (byte a = 0; a < APPS; a++) {
+			Next[a] = now + restartRandom(5000);
+			Burst[a] = 0;
+		}
+		uint32_t until = now + 20000 + restartRandom(20000);
+		run(now, until);
+		now = until;
+
+		//restart:
+		delete z21;
+		now += 500;		//boot time
+		Restarted = true;
+		Boot = now;
+		z21 = new z21Base<z21RestartHandler>();
+		step(now);
+		if (!cold)
+			z21->begin();
+		for (byte a = 0; a < APPS; a++) {
+			Correct[a] = -1;
+			BC[a] = false;
+		}
+		for (uint32_t ms = now; ms < now + 5000; ms++) {
+			step(ms);
+			for (byte a = 0; a < APPS; a++) {
+				if ((ms - now) % 1000 == a * 125) {	//App ask for its loco
+					byte info[] = {LAN_X_GET_LOCO_INFO, 0xF0, 0x00, (byte) (3 + a)};
+					appSend(a, LAN_X_Header, info, 4);
+				}
+			}
+			if (ms - now == 4000) {		//App 0 drive loco 3 again, broadcast to all
+				byte data[] = {LAN_X_SET_LOCO, 0x13, 0x00, 3, Truth[0][0]};
+				appSend(0, LAN_X_Header, data, 5);
+			}
+		}
+		for (byte a = 0; a < APPS; a++) {
+			if (Correct[a] >= 0) {
+				locos++;
+				time.push_back(Correct[a]);
+			}
+			clients += BC[a];
+		}
+		for (uint16_t t = 0; t < TRNTS; t++)
+			trnts += z21->getState().getTrnt(t) == TrntTruth[t];
+		now += 5000;
+		delete z21;
+	}
+
+	std::sort(time.begin(), time.end());
+	printf("restart:   %s, %u times\n", cold ? "cold (no begin)" : "warm (begin)", restarts);
+	printf("store:     %u Byte, %lu blocks written (%.1f per minute), %lu Byte\n", (unsigned int) z21PersistSize,
+		Writes, Writes * 60000.0 / now, WriteBytes);
+	if (time.empty())
+		printf("loco ms:   -\n");
+	else printf("loco ms:   p50 %u  max %u\n", time[(time.size() - 1) / 2], time.back());
+	printf("locos:     %lu of %u correct\n", locos, restarts * APPS);
+	printf("clients:   %lu of %u get broadcasts\n", clients, restarts * (APPS - 1));
+	printf("turnouts:  %lu of %u correct\n", trnts, restarts * TRNTS);
+	return 0;
+}
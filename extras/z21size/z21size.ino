@@ -0,0 +1,29 @@
+/*
+  z21size.ino - smallest sketch with the Z21 library for the size report (z21size.sh)
+  Copyright (c) 2026 Philipp Gahtow  All right reserved.
+
+  Notice:
+	- receive() get the messages from the serial port, so the compiler keep the whole protocol
+	- no notify function, each part of the protocol only cost the code inside the library
+*/
+
+#include <z21.h>
+z21Class z21;
+
+byte packet[24];	//one message, packet[0] = DataLen
+byte pos = 0;
+
+void setup() {
+	Serial.begin(115200);
+}
+
+void loop() {
+	while (Serial.available()) {
+		packet[pos++] = Serial.read();
+		if (pos == sizeof(packet) || pos == packet[0]) {
+			z21.receive(1, packet);
+			pos = 0;
+		}
+	}
+	z21.tick();
+}
@@ -0,0 +1,63 @@
+#!/bin/sh
+# z21size.sh - Flash and RAM of the Z21 library for each configuration (Z21NO..., z21.h)
+# Copyright (c) 2026 Philipp Gahtow  All right reserved.
+#
+# Notice:
+#	- with arduino-cli: build extras/z21size/z21size.ino for the board (default arduino:avr:mega),
+#	  Flash = "Sketch uses", RAM = "Global variables use"
+#	- -h (or without arduino-cli): code of z21.cpp (z21Base<z21WeakHandler>) and data of one z21Class
+#	  for the host PC, only to compare the configurations, not the size on a board
+#	- each line: the configuration, Flash and RAM, the difference to "full"
+#
+# Usage (from the library folder):
+#	extras/z21size/z21size.sh [-h] [fqbn] [-D... for all lines, e.g. -Dz21clientMAX=40]
+
+cd "$(dirname "$0")/../.." || exit 1
+
+CONFIGS="full -DZ21NOLOCONET -DZ21NOCAN -DZ21NORAILCOM -DZ21NOPOMACC -DZ21NOWLANMAUS -DZ21NOCONFIG -DZ21MINIMAL"
+HOST=0
+FQBN=arduino:avr:mega
+EXTRA=""
+for a in "$@"; do
+	case "$a" in
+		-h) HOST=1 ;;
+		-D*) EXTRA="$EXTRA $a" ;;
+		*) FQBN="$a" ;;
+	esac
+done
+command -v arduino-cli > /dev/null || HOST=1
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# Flash RAM of one configuration
+measure() {
+	flags="$EXTRA"
+	[ "$1" != "full" ] && flags="$flags $1"
+	if [ $HOST = 1 ]; then
+		printf '#include <Arduino.h>\n#include <EEPROM.h>\n#include <z21.h>\nz21Class z21;\n' > "$TMP/sketch.cpp"
+		for f in z21.cpp "$TMP/sketch.cpp"; do
+			g++ -std=gnu++11 -Os -DARDUINO=100 $flags -Iextras/host -I. -c "$f" -o "$TMP/$(basename "$f").o" 2> "$TMP/err" || { cat "$TMP/err" >&2; return 1; }
+		done
+		size "$TMP/z21.cpp.o" "$TMP/sketch.cpp.o" | awk 'NR == 2 { flash = $1 } NR == 3 { ram = $2 + $3 } END { print flash, ram }'
+	else
+		arduino-cli compile -b "$FQBN" --library . --build-path "$TMP/build" \
+			--build-property "compiler.cpp.extra_flags=$flags" extras/z21size > "$TMP/out" 2>&1 || { cat "$TMP/out" >&2; return 1; }
+		flash=$(sed -n 's/^Sketch uses \([0-9]*\) bytes.*/\1/p' "$TMP/out")
+		ram=$(sed -n 's/^Global variables use \([0-9]*\) bytes.*/\1/p' "$TMP/out")
+		echo "$flash $ram"
+	fi
+}
+
+if [ $HOST = 1 ]; then
+	echo "host PC (z21.cpp),$EXTRA"
+else
+	echo "$FQBN,$EXTRA"
+fi
+printf "%-16s %8s %8s %8s %8s\n" configuration flash ram "d flash" "d ram"
+for c in $CONFIGS; do
+	r=$(measure "$c") || exit 1
+	set -- $r
+	[ "$c" = "full" ] && { FULLF=$1; FULLR=$2; }
+	printf "%-16s %8d %8d %8d %8d\n" "$c" "$1" "$2" $(($1 - FULLF)) $(($2 - FULLR))
+done
@@ -0,0 +1,193 @@
+/*
+  z21watch.cpp - local reader of the shared memory state (z21export.h) on Linux
+  Copyright (c) 2026 Philipp Gahtow  All right reserved.
+
+  Notice:
+	- without -b: open the shared memory of a running command station and print each change
+	  of the power, locos, turnouts and S88 (wait() sleep until the next change)
+	- -b: benchmark inside this process, 8 Z21 Apps drive 32 locos (LAN_X_SET_LOCO_DRIVE):
+		apps		only the Apps
+		+client		one more LAN client with BC-Flag NetAll (the old way to get the state)
+		+export		z21ExportClass on the state instead of the LAN client
+	  report ns per command and datagrams per command, then the reads per second of z21ExportReader
+
+  Build (from the library folder):
+	g++ -std=gnu++11 -O2 -DARDUINO=100 -DZ21STATE -Iextras/host -I. extras/z21watch/z21watch.cpp extras/host/host.cpp z21state.cpp z21export.cpp -o z21watch
+
+  Usage:
+	z21watch [-b] [name]
+		name	of the shared memory, default z21ExportName (-b: /z21watch)
+*/
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <z21.h>
+#include <z21impl.h>
+#include <z21export.h>
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#if !defined(Z21STATE)
+#error "build with -DZ21STATE"
+#endif
+
+#define APPS 8
+#define LOCOS 32
+#define COMMANDS 200000
+
+static unsigned long Datagrams = 0;
+
+struct z21WatchHandler : z21NoHandler {
+	static inline void EthSend(uint8_t client, uint8_t *data) { Datagrams++; }
+};
+
+static uint64_t hostNanos() {
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+//--------------------------------------------------------------------------------------------
+static void send(z21Base<z21WatchHandler> &z21, byte client, unsigned int header, const byte *data, byte len) {
+	byte packet[24];
+	byte xorbyte = 0;
+	packet[0] = len + 4 + (header == LAN_X_Header);
+	packet[1] = 0;
+	packet[2] = header & 0xFF;
+	packet[3] = header >> 8;
+	for (byte i = 0; i < len; i++) {
+		packet[4 + i] = data[i];
+		xorbyte ^= data[i];
+	}
+	if (header == LAN_X_Header)
+		packet[4 + len] = xorbyte;
+	z21.receive(client, packet);
+}
+
+//one run: 0 = apps, 1 = +client, 2 = +export
+static void bench(byte mode, const char *name) {
+	z21Base<z21WatchHandler> z21;
+	z21ExportClass exporter;
+	byte client[APPS];
+	for (byte a = 0; a < APPS; a++)
+		client[a] = z21.getClient(0xC0A80000UL | (10 + a), 50000 + a);
+	if (mode == 1) {
+		byte flags[4] = {0x01, 0x00, 0x01, 0x00};	//Z21bcAll | Z21bcNetAll
+		send(z21, z21.getClient(0xC0A80064UL, 21105), LAN_SET_BROADCASTFLAGS, flags, 4);
+	}
+	if (mode == 2 && !exporter.begin(z21.getState(), name)) {
+		perror(name);
+		exit(1);
+	}
+	Datagrams = 0;
+	uint64_t busy = 0;
+	for (unsigned long i = 0; i < COMMANDS; i++) {
+		z21HostTime = i * 100;
+		byte a = i % APPS;
+		uint16_t adr = 3 + (i % LOCOS);
+		byte drive[5] = {LAN_X_SET_LOCO, 0x13, (byte) (adr >> 8), (byte) adr, (byte) (0x80 | (i & 0x7F))};
+		uint64_t t0 = hostNanos();
+		send(z21, client[a], LAN_X_Header, drive, 5);
+		busy += hostNanos() - t0;
+	}
+	const char *title[] = {"apps", "+client", "+export"};
+	printf("%-10s %8.0f %10.2f\n", title[mode], (double) busy / COMMANDS, (double) Datagrams / COMMANDS);
+
+	if (mode == 2) {	//reader of the same memory
+		z21ExportReader reader;
+		if (!reader.open(name)) {
+			fprintf(stderr, "%s: no export\n", name);
+			exit(1);
+		}
+		byte data[6];
+		unsigned long found = 0;
+		uint64_t t0 = hostNanos();
+		for (unsigned long i = 0; i < COMMANDS * 10; i++)
+			found += reader.getLoco(3 + (i % LOCOS), data);
+		uint64_t dt = hostNanos() - t0;
+		printf("\nreader: %.1f ns per getLoco (%lu found), %.0f reads/s\n",
+			(double) dt / (COMMANDS * 10), found, COMMANDS * 10 * 1e9 / dt);
+		reader.close();
+		exporter.end();
+		shm_unlink(name);
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//print the changes of a running command station
+static int watch(const char *name) {
+	z21ExportReader reader;
+	while (!reader.open(name)) {
+		fprintf(stderr, "%s: wait for the command station\n", name);
+		sleep(1);
+	}
+	byte power = reader.getPower();
+	uint16_t adr[z21StateLocoMAX];
+	byte loco[z21StateLocoMAX][6];
+	byte s88[z21ExportS88MAX];
+	byte trnt[z21StateTrntMAX / 8];
+	memset(adr, 0, sizeof(adr));
+	memset(s88, 0, sizeof(s88));
+	memset(trnt, 0, sizeof(trnt));
+	printf("power 0x%02X\n", power);
+	uint32_t change = reader.getChange();
+	while (true) {
+		if (!reader.wait(change, 1000))
+			continue;
+		change = reader.getChange();
+		byte p = reader.getPower();
+		if (p != power)
+			printf("power 0x%02X\n", p);
+		power = p;
+		for (byte i = 0; i < z21StateLocoMAX; i++) {
+			uint16_t a;
+			byte data[6];
+			if (!reader.getLocoSlot(i, a, data) || (a == adr[i] && memcmp(loco[i], data, 6) == 0))
+				continue;
+			printf("loco %u speed 0x%02X F0 0x%02X F5 0x%02X F13 0x%02X F21 0x%02X\n",
+				a, data[1], data[2], data[3], data[4], data[5]);
+			adr[i] = a;
+			memcpy(loco[i], data, 6);
+		}
+		for (uint16_t t = 0; t < z21StateTrntMAX; t++) {
+			bool pos = reader.getTrnt(t);
+			if (pos != bitRead(trnt[t >> 3], t & 0x07)) {
+				printf("turnout %u %d\n", t, pos);
+				bitWrite(trnt[t >> 3], t & 0x07, pos);
+			}
+		}
+		byte s[z21ExportS88MAX];
+		reader.getS88(s);
+		for (byte m = 0; m < z21ExportS88MAX; m++) {
+			if (s[m] != s88[m])
+				printf("s88 module %d 0x%02X\n", m + 1, s[m]);
+		}
+		memcpy(s88, s, sizeof(s88));
+		fflush(stdout);
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------------------------------
+int main(int argc, char **argv) {
+	bool benchmark = false;
+	const char *name = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-b") == 0)
+			benchmark = true;
+		else name = argv[i];
+	}
+	if (!benchmark)
+		return watch(name ? name : z21ExportName);
+	if (name == NULL)
+		name = "/z21watch";		//not the memory of a running command station
+
+	printf("%d Apps, %d locos, %d commands\n\n", APPS, LOCOS, COMMANDS);
+	printf("run           ns/cmd  datagrams/cmd\n");
+	for (byte mode = 0; mode < 3; mode++)
+		bench(mode, name);
+	return 0;
+}
@@ -1,250 +1,854 @@
-/*
-  z21.h - library for Z21 mobile protocoll
-  Copyright (c) 2013-2022 Philipp Gahtow  All right reserved.
-
-  ROCO Z21 LAN Protocol for Arduino.
-  
-  Notice:
-	- analyse the data and give back the content and a answer
-
-  Grundlage: Z21 LAN Protokoll Spezifikation V1.12
-
-  nderungen:
-	- 23.09.15 Anpassung LAN_LOCONET_DETECTOR
-			   Fehlerbeseitigung bei der LAN Prfsumme
-			   Anpassung LAN_LOCONET_DISPATCH
-	- 14.07.16 add S88 Gruppenindex for request
-	- 22.08.16 add POM read notify
-	- 19.12.16 add CV return value for Service Mode
-	- 27.12.16 add CV no ACK and CV Short Circuit
-	- 15.03.17 add System Information
-	- 03.04.17 fix LAN_X_SET_LOCO_FUNCTION in DB3 type and index
-	- 14.04.17 add EEPROM and store Z21 configuration (EEPROM: 50-75)
-	- 19.06.17 add FW Version 1.28, 1.29 and 1.30
-	- 06.08.17 add support for Arduino DUE
-	- 27.08.17 fix speed step setting
-	- 09.01.18 adjust POM write Byte and Bit
-	- 21.01.18 adjust notifyz21LNdispatch to long Adr
-	- 04.02.18 fix LocoNet dispatch
-	- 22.10.18 add loco busy return
-	- 02.11.18 adjust returnLocoStateFull with addition non broadcast when requestion only information
-	- 04.11.18 fix EthSend handel of message with client == 0 and Broadcast with client and without
-	- 10.05.20 add message LAN_GET_LOCOMODE and LAN_GET_TURNOUTMODE
-	- 04.08.20 fix POM set CV result
-	- 17.12.20 add support for ESP32 and adjust ESP8266
-	- 01.03.21 set default EEPROM MainV and ProgV to 20V
-	- 03.03.21 add new Z21 spezifications v1.10
-	- 21.03.21 add request for client identification (ip-hash) and store this plus BC-Flag in EEPROM
-	- 30.03.21 fix connecting problem WDP with reporting railpower when request status
-	- 11.06.21 add NVS on ESP32 to store EEPROM data
-	- 30.09.21 fix storage data in Ethsend with correct datalength; fix problem with LAN_X_GET_TURNOUT_INFO to return feedbacks also when LAN_X_SET_TURNOUT is called!
-	- 06.11.21 fix EEPROM store BCFlags with IP Hash value. Use EEPROM value from 512 up to 736.
-	- 16.11.21 add sending data to client only with "Z21bcNone", if client set and BC-Flag set (not "Z21bcNone") then don't inform the client!
-	- 14.12.21 limit max packet size for Z21 LocoNet tunnel data to 20 bytes!
-	- 03.02.22 fix setCANDetector() data values with 16bit
-	- 10.02.22 add LAN_X_CV_POM_ACCESSORY statements
-	- 24.04.22 add SystemState.Capabilities for feature report to clients (FW Version 1.42)
-			   modify LAN_X_LOCO_INFO to FW Version 1.42
-	- 25.04.22 add LAN_X_SET_LOCO_FUNCTION_GROUP and LAN_X_SET_LOCO_BINARY_STATE
-			   fix SET_EXT_ACCESSORY and EXT_ACCESSORY_INFO
-	- 29.04.22 add WLANMaus CV Read and write special functions		   
-*/
-
-// include types & constants of Wiring core API
-#if defined(WIRING)
- #include <Wiring.h>
-#elif ARDUINO >= 100
- #include <Arduino.h>
-#else
- #include <WProgram.h>
-#endif
-
-//--------------------------------------------------------------
-#define z21Port 21105      // local port to listen on
-
-//**************************************************************
-//#define SERIALDEBUG		//Serial Debug
-
-#if defined(SERIALDEBUG)
-#define ZDebug Serial	//Port for the Debugging
-#endif
-
-//**************************************************************
-//Firmware-Version der Z21:
-#define z21FWVersionMSB 0x01
-#define z21FWVersionLSB 0x42
-/*
-HwType:
-#define D_HWT_Z21_OLD 0x00000200 // schwarze Z21 (Hardware-Variante ab 2012)
-#define D_HWT_Z21_NEW 0x00000201 // schwarze Z21(Hardware-Variante ab 2013)
-#define D_HWT_SMARTRAIL 0x00000202 // SmartRail (ab 2012)
-#define D_HWT_z21_SMALL 0x00000203 // weie z21 Starterset-Variante (ab 2013)
-#define D_HWT_z21_START 0x00000204 // z21 start Starterset-Variante (ab 2016) 
-#define D_HWT_Z21_XL 0x00000211 // 10870 Z21 XL Series (ab 2020) 
-#define D_HWT_SINGLE_BOOSTER 0x00000205 // 10806 Z21 Single Booster (zLink) 
-#define D_HWT_DUAL_BOOSTER 0x00000206 // 10807 Z21 Dual Booster (zLink) 
-#define D_HWT_Z21_SWITCH_DECODER 0x00000301 // 10836 Z21 SwitchDecoder (zLink) 
-#define D_HWT_Z21_SIGNAL_DECODER 0x00000302 // 10836 Z21 SignalDecoder (zLink)
-*/
-//Hardware-Typ: 0x00000211 // 10870 Z21 XL Series (ab 2020) 
-#define z21HWTypeMSB 0x02
-#define z21HWTypeLSB 0x11
-//Seriennummer inside EEPROM:
-#define CONFz21SnMSB 0		//0x01
-#define CONFz21SnLSB 1		//0xE8
-//**************************************************************
-//Store Z21 configuration inside EEPROM:
-#define CONF1STORE 50 	//(10x Byte)	- Prog, RailCom, etc.
-#define CONF2STORE 60	//(15x Byte)	- Voltage: Prog, Rail, etc.
-#define CLIENTHASHSTORE 0x200		//512 Start where Client-Hash is stored
-
-//--------------------------------------------------------------
-//certain global XPressnet status indicators:
-#define csNormal 0x00 			// Normal Operation Resumed ist eingeschaltet
-#define csEmergencyStop 0x01	// Der Nothalt ist eingeschaltet
-#define csTrackVoltageOff 0x02  // Die Gleisspannung ist abgeschaltet
-#define csShortCircuit 0x04 	// Kurzschluss
-#define csServiceMode 0x08 		// Der Programmiermodus ist aktiv - Service Mode
-//Bitmask CentralStateEx:
-#define cseHighTemperature  0x01 // zu hohe Temperatur 
-#define csePowerLost  0x02 // zu geringe Eingangsspannung 
-#define cseShortCircuitExternal 0x04 // am externen Booster-Ausgang 
-#define cseShortCircuitInternal 0x08 // am Hauptgleis oder Programmiergleis 
-
-//--------------------------------------------------------------
-#define z21clientMAX 30        //Speichergre fr IP-Adressen
-#define z21ActTimeIP 20    //Aktivhaltung einer IP fr (sec./2)
-#define z21IPinterval 2000   //interval at milliseconds
-
-//DCC Speed Steps
-#define DCCSTEP14	0x01
-#define DCCSTEP28	0x02
-#define DCCSTEP128	0x03
-
-struct TypeActIP {
-  byte client;    // Byte client
-  byte BCFlag;  //BoadCastFlag - see Z21type.h
-  byte time;  //Zeit
-  uint16_t adr;		//Loco control Adr
-};
-
-// library interface description
-class z21Class
-{
-  // user-accessible "public" interface
-  public:
-	z21Class(void);	//Constuctor
-
-	void receive(uint8_t client, uint8_t *packet);				//Prfe auf neue Ethernet Daten
-	
-	void setPower(byte state);		//Zustand Gleisspannung Melden
-	byte getPower();		//Zusand Gleisspannung ausgeben
-	
-	void setCVPOMBYTE (uint16_t CVAdr, uint8_t value);	//POM write byte return
-	
-	void setLocoStateExt (int Adr);	//send Loco state to BC
-	unsigned long getz21BcFlag (byte flag);	//Convert local stored flag back into a Z21 Flag
-	
-	void setS88Data(byte *data);	//return state of S88 sensors
-
-	void setLNDetector(uint8_t client, byte *data, byte DataLen);	//return state from LN detector
-	bool setLNMessage(byte *data, byte DataLen, byte bcType, bool TX);	//return LN Message
-	
-	void setCANDetector(uint16_t NID, uint16_t Adr, uint8_t port, uint8_t typ, uint16_t v1, uint16_t v2); //state from CAN detector
-
-	void setTrntInfo(uint16_t Adr, bool State); //Return the state of accessory
-	
-	void setExtACCInfo(uint16_t Adr, byte State, bool Status = 0x00);	//Return EXT Accessory INFO
-	
-	void setCVReturn (uint16_t CV, uint8_t value);	//Return CV Value for Programming
-	void setCVNack();	//Return no ACK from Decoder
-	void setCVNackSC();	//Return Short while Programming
-	
-	void sendSystemInfo(byte client, uint16_t maincurrent, uint16_t mainvoltage, uint16_t temp); 	//Send to all clients that request via BC the System Information
-	
-  // library-accessible "private" interface
-  private:
-
-		//Variables:
-	byte Railpower;				//state of the railpower
-	long z21IPpreviousMillis;        // will store last time of IP decount updated  
-	TypeActIP ActIP[z21clientMAX];    //Speicherarray fr IPs
-	
-		//Functions:
-	void returnLocoStateFull (byte client, uint16_t Adr, bool bc);  //Antwort auf Statusabfrage
-	void EthSend (byte client, unsigned int DataLen, unsigned int Header, byte *dataString, boolean withXOR, byte BC);
-	byte getLocalBcFlag (unsigned long flag);  //Convert Z21 LAN BC flag to local stored flag
-	void clearIP (byte pos);		//delete the stored client
-	void clearIPSlots();			//delete all stored clients
-	void clearIPSlot(byte client);	//delete a client
-	byte addIPToSlot (byte client, byte BCFlag);
-	
-	void setOtherSlotBusy(byte slot);
-	void addBusySlot (byte client, uint16_t adr);
-	void reqLocoBusy (uint16_t adr);
-	
-	byte getEEPROMBCFlagIndex();		//return the length of BC-Flag store
-	void setEEPROMBCFlag(byte IPHash, byte BCFlag);		//add BC-Flag to store
-	byte findEEPROMBCFlag(byte IPHash);		//read the BC-Flag for this client
-	
-	uint8_t LAST_EXTACC_msg = 0x00;		//for LAN_X_GET_EXT_ACCESSORY_INFO
-	bool LAST_EXTACC_received = false;	//already had any EXTACC Message?
-};
-
-#if defined (__cplusplus)
-	extern "C" {
-#endif
-
-	extern void notifyz21getSystemInfo(uint8_t client) __attribute__((weak));
-	
-	extern void notifyz21EthSend(uint8_t client, uint8_t *data) __attribute__((weak));
-
-	extern void notifyz21LNdetector(uint8_t client, uint8_t typ, uint16_t Adr) __attribute__((weak));
-	extern uint8_t notifyz21LNdispatch(uint16_t Adr) __attribute__((weak));
-	extern void notifyz21LNSendPacket(uint8_t *data, uint8_t length) __attribute__((weak));
-	
-	extern void notifyz21CANdetector(uint8_t client, uint8_t typ, uint16_t ID) __attribute__((weak));
-	
-	extern void notifyz21RailPower(uint8_t State ) __attribute__((weak));
-	
-	extern void notifyz21CVREAD(uint8_t cvAdrMSB, uint8_t cvAdrLSB) __attribute__((weak));
-	extern void notifyz21CVWRITE(uint8_t cvAdrMSB, uint8_t cvAdrLSB, uint8_t value) __attribute__((weak));
-	extern void notifyz21CVPOMWRITEBYTE(uint16_t Adr, uint16_t cvAdr, uint8_t value) __attribute__((weak));
-	extern void notifyz21CVPOMWRITEBIT(uint16_t Adr, uint16_t cvAdr, uint8_t value) __attribute__((weak));
-	extern void notifyz21CVPOMREADBYTE(uint16_t Adr, uint16_t cvAdr) __attribute__((weak));
-	extern void notifyz21CVPOMACCWRITEBYTE(uint16_t Adr, uint16_t cvAdr, uint8_t value) __attribute__((weak));
-	extern void notifyz21CVPOMACCWRITEBIT(uint16_t Adr, uint16_t cvAdr, uint8_t value) __attribute__((weak));
-	extern void notifyz21CVPOMACCREADBYTE(uint16_t Adr, uint16_t cvAdr) __attribute__((weak));
-	
-	extern uint8_t notifyz21AccessoryInfo(uint16_t Adr) __attribute__((weak));
-	extern void notifyz21Accessory(uint16_t Adr, bool state, bool active) __attribute__((weak));
-	extern void notifyz21ExtAccessory(uint16_t Adr, byte state) __attribute__((weak));
-		
-	extern void notifyz21LocoState(uint16_t Adr, uint8_t data[]) __attribute__((weak));
-	extern void notifyz21LocoFkt(uint16_t Adr, uint8_t type, uint8_t fkt) __attribute__((weak));
-	extern void notifyz21LocoFkt0to4(uint16_t Adr, uint8_t fkt) __attribute__((weak));
-	extern void notifyz21LocoFkt5to8(uint16_t Adr, uint8_t fkt) __attribute__((weak));
-	extern void notifyz21LocoFkt9to12(uint16_t Adr, uint8_t fkt) __attribute__((weak));
-	extern void notifyz21LocoFkt13to20(uint16_t Adr, uint8_t fkt) __attribute__((weak));
-	extern void notifyz21LocoFkt21to28(uint16_t Adr, uint8_t fkt) __attribute__((weak));
-	extern void notifyz21LocoFkt29to36(uint16_t Adr, uint8_t fkt) __attribute__((weak));
-	extern void notifyz21LocoFkt37to44(uint16_t Adr, uint8_t fkt) __attribute__((weak));
-	extern void notifyz21LocoFkt45to52(uint16_t Adr, uint8_t fkt) __attribute__((weak));
-	extern void notifyz21LocoFkt53to60(uint16_t Adr, uint8_t fkt) __attribute__((weak));
-	extern void notifyz21LocoFkt61to68(uint16_t Adr, uint8_t fkt) __attribute__((weak));
-	extern void notifyz21LocoFktExt(uint16_t Adr, uint8_t low, uint8_t high) __attribute__((weak));
-	extern void notifyz21LocoSpeed(uint16_t Adr, uint8_t speed, uint8_t steps) __attribute__((weak));
-	
-	extern void notifyz21S88Data(uint8_t gIndex) __attribute__((weak));	//return last state S88 Data for the Client!
-	
-	extern uint16_t notifyz21Railcom() __attribute__((weak));	//return global Railcom Adr
-	
-	extern void notifyz21UpdateConf() __attribute__((weak)); //information for DCC via EEPROM (RailCom, ProgMode,...)
-	
-	extern uint8_t notifyz21ClientHash(uint8_t client) __attribute__((weak));
-
-#if defined (__cplusplus)
-}
-#endif
-
-
+/*
+  z21.h - library for Z21 mobile protocoll
+  Copyright (c) 2013-2022 Philipp Gahtow  All right reserved.
+
+  ROCO Z21 LAN Protocol for Arduino.
+  
+  Notice:
+	- analyse the data and give back the content and a answer
+
+  Grundlage: Z21 LAN Protokoll Spezifikation V1.12
+
+  Änderungen:
+	- 23.09.15 Anpassung LAN_LOCONET_DETECTOR
+			   Fehlerbeseitigung bei der LAN Prüfsumme
+			   Anpassung LAN_LOCONET_DISPATCH
+	- 14.07.16 add S88 Gruppenindex for request
+	- 22.08.16 add POM read notify
+	- 19.12.16 add CV return value for Service Mode
+	- 27.12.16 add CV no ACK and CV Short Circuit
+	- 15.03.17 add System Information
+	- 03.04.17 fix LAN_X_SET_LOCO_FUNCTION in DB3 type and index
+	- 14.04.17 add EEPROM and store Z21 configuration (EEPROM: 50-75)
+	- 19.06.17 add FW Version 1.28, 1.29 and 1.30
+	- 06.08.17 add support for Arduino DUE
+	- 27.08.17 fix speed step setting
+	- 09.01.18 adjust POM write Byte and Bit
+	- 21.01.18 adjust notifyz21LNdispatch to long Adr
+	- 04.02.18 fix LocoNet dispatch
+	- 22.10.18 add loco busy return
+	- 02.11.18 adjust returnLocoStateFull with addition non broadcast when requestion only information
+	- 04.11.18 fix EthSend handel of message with client == 0 and Broadcast with client and without
+	- 10.05.20 add message LAN_GET_LOCOMODE and LAN_GET_TURNOUTMODE
+	- 04.08.20 fix POM set CV result
+	- 17.12.20 add support for ESP32 and adjust ESP8266
+	- 01.03.21 set default EEPROM MainV and ProgV to 20V
+	- 03.03.21 add new Z21 spezifications v1.10
+	- 21.03.21 add request for client identification (ip-hash) and store this plus BC-Flag in EEPROM
+	- 30.03.21 fix connecting problem WDP with reporting railpower when request status
+	- 11.06.21 add NVS on ESP32 to store EEPROM data
+	- 30.09.21 fix storage data in Ethsend with correct datalength; fix problem with LAN_X_GET_TURNOUT_INFO to return feedbacks also when LAN_X_SET_TURNOUT is called!
+	- 06.11.21 fix EEPROM store BCFlags with IP Hash value. Use EEPROM value from 512 up to 736.
+	- 16.11.21 add sending data to client only with "Z21bcNone", if client set and BC-Flag set (not "Z21bcNone") then don't inform the client!
+	- 14.12.21 limit max packet size for Z21 LocoNet tunnel data to 20 bytes!
+	- 03.02.22 fix setCANDetector() data values with 16bit
+	- 10.02.22 add LAN_X_CV_POM_ACCESSORY statements
+	- 24.04.22 add SystemState.Capabilities for feature report to clients (FW Version 1.42)
+			   modify LAN_X_LOCO_INFO to FW Version 1.42
+	- 25.04.22 add LAN_X_SET_LOCO_FUNCTION_GROUP and LAN_X_SET_LOCO_BINARY_STATE
+			   fix SET_EXT_ACCESSORY and EXT_ACCESSORY_INFO
+	- 29.04.22 add WLANMaus CV Read and write special functions		   
+	- 18.10.26 store EXT Accessory state per address for LAN_X_GET_EXT_ACCESSORY_INFO
+			   route LocoNet tunnel messages by opcode class (Locos, Switches, GBM)
+			   store full 32 bit BC-Flag per client, EEPROM BC-Flag with 16 bit (High Byte at 768 up to 1023)
+			   new client get only for himself a snapshot (power, BC-Flag, turnouts) in one datagram
+			   table of pending CV requests, CV results only to the request clients
+			   add optional statistic (Z21STATS) with counter and time histogram, LAN_DIAG_GETSTATS
+			   add binary trace ring (Z21TRACE) instead of the SERIALDEBUG prints inside receive() and EthSend()
+			   add optional event queue (Z21EVENTQUEUE) for the DCC commands, the DCC task get them with poll()
+			   add optional state store (Z21STATE) with sequence counter per loco, read without lock by other tasks
+			   z21Class is now z21Base<z21WeakHandler>, an own Handler (z21impl.h) call the hooks without weak functions
+			   more then one z21Class (Ethernet, WiFi) can share one state (Z21STATE, attach)
+			   add notifyz21Capture for recording of all messages (z21capture.h), replay tool in extras
+			   z21clientMAX can be set by the compiler (max. 255), load generator for many clients in extras
+			   add optional send queue for each client (Z21SENDQUEUE, notifyz21EthReady), latest state wins
+			   priority of the queued messages: safety (power, stop) first, bulk is lost first
+			   add client table by IP and port (getClient, getEndpoint), aged together with the client
+			   add DCC packet encoder for the received commands (z21dcc.h), benchmark in extras
+			   add DCC refresh scheduler (z21refresh.h): changes first, stopped locos less often, oldest loco removed
+			   virtual command station for the host tools (DCC timing, programming track), latency report in z21load -c
+			   add optional turnout queue (Z21ACCQUEUE): coil pulse by tick(), limit of active coils, time of a route
+			   add optional stored state (Z21PERSIST) in blocks with CRC, written by tick(), begin() restore it with the track off (Z21PERSISTDCC: drive on); test in extras
+			   add state in shared memory for local programs on Linux (z21export.h, z21ExportReader), reader without fence for other locos
+			   add Z21NO... and Z21MINIMAL to build without LocoNet, CAN, RailCom, POM accessory, WLANmaus, config; size report in extras
+			   add threaded engine on Linux (z21shard.h), shards by loco/accessory address, lock free queues, sender merge datagrams
+			   add optional system state scheduler (Z21SYSINFO): samples at any rate, real FilteredMainCurrent, deadband and rate limit
+*/
+
+// include types & constants of Wiring core API
+#if defined(WIRING)
+ #include <Wiring.h>
+#elif ARDUINO >= 100
+ #include <Arduino.h>
+#else
+ #include <WProgram.h>
+#endif
+
+#include "z21state.h"
+
+//--------------------------------------------------------------
+#define z21Port 21105      // local port to listen on
+
+//**************************************************************
+//#define SERIALDEBUG		//Serial Debug
+
+#if defined(SERIALDEBUG)
+#define ZDebug Serial	//Port for the Debugging
+#define Z21TRACE		//read the trace with traceDrain(ZDebug) inside loop()
+#endif
+
+//#define Z21TRACE		//binary trace of all received and sent messages, without blocking
+
+//#define Z21STATS		//Statistic: counter and time histogram of receive() and EthSend()
+
+//#define Z21EVENTQUEUE	//receive() only store the DCC commands, call poll() inside the DCC task
+
+//#define Z21STATE		//store power, loco and turnout state inside the library, other tasks read it with getState()
+
+//#define Z21SENDQUEUE	//queue for each client (with notifyz21EthReady), a newer state replace the older message, safety first; no merged datagrams
+
+//#define Z21ACCQUEUE	//turnout commands in a queue, tick() switch the coils off after the pulse, limit of active coils
+
+//#define Z21PERSIST	//power, clients (with Z21STATE locos and turnouts) in blocks with CRC, tick() store the changes, begin() restore
+						//the clients and the state, the track stay off and the locos stopped (direction and functions kept)
+//#define Z21PERSISTDCC	//with Z21PERSIST: begin() also switch the stored power on and send the stored speed and F0 - F28 to DCC,
+						//locos drive again without a user at the throttle! a block is stored max. each z21PersistInterval
+
+//#define Z21SYSINFO	//setSystemInfo() at any rate, tick() send LAN_SYSTEMSTATE_DATACHANGED on change (deadband) or after max. ms
+
+//without the protocol parts that the sketch don't use (Flash and RAM for small boards), the client get LAN_X_UNKNOWN_COMMAND:
+//#define Z21NOLOCONET	//LocoNet tunnel and detector: LAN_LOCONET_*, setLNDetector, setLNMessage, notifyz21LN...
+//#define Z21NOCAN		//CAN detector: LAN_CAN_DETECTOR, setCANDetector, notifyz21CANdetector
+//#define Z21NORAILCOM	//LAN_RAILCOM_GETDATA, notifyz21Railcom
+//#define Z21NOPOMACC	//POM of accessory decoders: notifyz21CVPOMACC...
+//#define Z21NOWLANMAUS	//special cases of the WLANmaus: CV read/write, periodic request 0x73 (set the BC-Flag)
+//#define Z21NOCONFIG	//configuration 0x12, 0x13, 0x16, 0x17 inside EEPROM, notifyz21UpdateConf
+//#define Z21MINIMAL	//all of the above
+
+//**************************************************************
+//Firmware-Version der Z21:
+#define z21FWVersionMSB 0x01
+#define z21FWVersionLSB 0x42
+/*
+HwType:
+#define D_HWT_Z21_OLD 0x00000200 // schwarze Z21 (Hardware-Variante ab 2012)
+#define D_HWT_Z21_NEW 0x00000201 // schwarze Z21(Hardware-Variante ab 2013)
+#define D_HWT_SMARTRAIL 0x00000202 // SmartRail (ab 2012)
+#define D_HWT_z21_SMALL 0x00000203 // weiße z21 Starterset-Variante (ab 2013)
+#define D_HWT_z21_START 0x00000204 // z21 start Starterset-Variante (ab 2016) 
+#define D_HWT_Z21_XL 0x00000211 // 10870 Z21 XL Series (ab 2020) 
+#define D_HWT_SINGLE_BOOSTER 0x00000205 // 10806 Z21 Single Booster (zLink) 
+#define D_HWT_DUAL_BOOSTER 0x00000206 // 10807 Z21 Dual Booster (zLink) 
+#define D_HWT_Z21_SWITCH_DECODER 0x00000301 // 10836 Z21 SwitchDecoder (zLink) 
+#define D_HWT_Z21_SIGNAL_DECODER 0x00000302 // 10836 Z21 SignalDecoder (zLink)
+*/
+//Hardware-Typ: 0x00000211 // 10870 Z21 XL Series (ab 2020) 
+#define z21HWTypeMSB 0x02
+#define z21HWTypeLSB 0x11
+//Seriennummer inside EEPROM:
+#define CONFz21SnMSB 0		//0x01
+#define CONFz21SnLSB 1		//0xE8
+//**************************************************************
+//Store Z21 configuration inside EEPROM:
+#define CONF1STORE 50 	//(10x Byte)	- Prog, RailCom, etc.
+#define CONF2STORE 60	//(15x Byte)	- Voltage: Prog, Rail, etc.
+#define CLIENTHASHSTORE 0x200		//512 Start where Client-Hash is stored
+#define CLIENTHASHSTOREHIGH 0x300	//768 Start where the High Byte of the BC-Flag is stored
+
+//--------------------------------------------------------------
+//certain global XPressnet status indicators:
+#define csNormal 0x00 			// Normal Operation Resumed ist eingeschaltet
+#define csEmergencyStop 0x01	// Der Nothalt ist eingeschaltet
+#define csTrackVoltageOff 0x02  // Die Gleisspannung ist abgeschaltet
+#define csShortCircuit 0x04 	// Kurzschluss
+#define csServiceMode 0x08 		// Der Programmiermodus ist aktiv - Service Mode
+//Bitmask CentralStateEx:
+#define cseHighTemperature  0x01 // zu hohe Temperatur 
+#define csePowerLost  0x02 // zu geringe Eingangsspannung 
+#define cseShortCircuitExternal 0x04 // am externen Booster-Ausgang 
+#define cseShortCircuitInternal 0x08 // am Hauptgleis oder Programmiergleis 
+
+//--------------------------------------------------------------
+//protocol parts (Z21NO...), the saved Flash and RAM can go to z21clientMAX or Z21STATE:
+#if defined(Z21MINIMAL)
+#define Z21NOLOCONET
+#define Z21NOCAN
+#define Z21NORAILCOM
+#define Z21NOPOMACC
+#define Z21NOWLANMAUS
+#define Z21NOCONFIG
+#endif
+
+//BC-Flags of the compiled parts, LAN_SET_BROADCASTFLAGS store only these:
+#if defined(Z21NOLOCONET)
+#define z21BcNoLocoNet (Z21bcLocoNet | Z21bcLocoNetLocos | Z21bcLocoNetSwitches | Z21bcLocoNetGBM)
+#else
+#define z21BcNoLocoNet 0
+#endif
+#if defined(Z21NOCAN)
+#define z21BcNoCAN Z21bcCANDetector
+#else
+#define z21BcNoCAN 0
+#endif
+#if defined(Z21NORAILCOM)
+#define z21BcNoRailCom (Z21bcRailcom | Z21bcRailComAll)
+#else
+#define z21BcNoRailCom 0
+#endif
+#define z21BcMask (~(unsigned long) (z21BcNoLocoNet | z21BcNoCAN | z21BcNoRailCom))
+
+//--------------------------------------------------------------
+#if !defined(z21clientMAX)
+#define z21clientMAX 30        //Speichergröße für IP-Adressen (max. 255)
+#endif
+#define z21ActTimeIP 20    //Aktivhaltung einer IP für (sec./2)
+#define z21IPinterval 2000   //interval at milliseconds
+
+//open addressing table IP and port -> client slot (2^n, more then z21clientMAX):
+#if z21clientMAX <= 32
+#define z21EndpointHashMAX 64
+#elif z21clientMAX <= 64
+#define z21EndpointHashMAX 128
+#elif z21clientMAX <= 128
+#define z21EndpointHashMAX 256
+#else
+#define z21EndpointHashMAX 512
+#endif
+
+//Snapshot for a new client:
+#define z21SnapshotTrnt 0	//Anzahl Weichen (ab Adr 0) deren Zustand ein neuer Client erhält, 0 = aus
+#if defined(__AVR__)
+#define z21TXBufferSize 64		//max. Größe eines zusammengefassten Datagramms
+#else
+#define z21TXBufferSize 512		//max. Größe eines zusammengefassten Datagramms
+#endif
+
+//Pending CV requests (Service Mode and POM read):
+#if defined(__AVR__)
+#define z21CVReqMAX 4		//Anzahl offener CV Anfragen
+#else
+#define z21CVReqMAX 8		//Anzahl offener CV Anfragen
+#endif
+#define z21CVReqClientMAX 4	//Clients je CV Anfrage
+#define z21CVTimeout 5000	//ms bis LAN_X_CV_NACK an die Clients gemeldet wird
+
+#define z21ExtAccMAX 32		//Speichergröße für Erweiterte Zubehördecoder (2^n!)
+#define z21ExtAccProbe 4	//max. Suchschritte im Speicher, danach wird der erste Eintrag überschrieben
+#define z21ExtAccFree 0xFFFF	//Speicherplatz nicht belegt
+
+#if defined(Z21EVENTQUEUE)
+#if defined(__AVR__)
+#define z21EventMAX 16		//Anzahl Kommandos in der Warteschlange (2^n, max. 128!)
+#else
+#define z21EventMAX 64		//Anzahl Kommandos in der Warteschlange (2^n, max. 128!)
+#endif
+#define z21CVResultMAX 4	//Ergebnisse der DCC-Task für tick() (2^n)
+#endif
+
+#if defined(Z21SENDQUEUE)
+#if defined(__AVR__)
+#define z21SendQueueMAX 2		//Nachrichten je Client
+#else
+#define z21SendQueueMAX 8		//Nachrichten je Client
+#endif
+#define z21SendQueueData 24		//max. Größe einer Nachricht in der Warteschlange
+
+//Priority of a message, the queue send the lowest number first and lose the highest first:
+#define z21PrioSafety	0	//track power, stop, short circuit
+#define z21PrioControl	1	//LOCO_INFO, TURNOUT_INFO, CV result and answers
+#define z21PrioFeedback	2	//RMBUS, RailCom, LocoNet and CAN detector
+#define z21PrioBulk		3	//LocoNet tunnel, SystemState, statistic
+
+struct TypeZ21SendMsg {
+  uint32_t key;		//Header, X-Header and Adr of a state message, 0 = event (never replaced)
+  byte prio;		//z21Prio...
+  byte data[z21SendQueueData];	//message with DataLen and Header
+};
+
+struct TypeZ21SendQueue {
+  byte count;		//msg[0] is the oldest
+  TypeZ21SendMsg msg[z21SendQueueMAX];
+};
+#endif
+
+#if defined(Z21ACCQUEUE)
+#if defined(__AVR__)
+#define z21AccQueueMAX 16		//wartende Weichenbefehle
+#else
+#define z21AccQueueMAX 64		//wartende Weichenbefehle
+#endif
+#define z21AccActiveMAX 8		//max. gleichzeitig aktive Spulen (setAccPulse)
+#define z21AccActive 2			//default: gleichzeitig aktive Spulen
+#define z21AccPulse 100			//default: ms Spule EIN
+
+struct TypeZ21AccCmd {
+  uint16_t adr;		//Adr like notifyz21Accessory
+  byte state;		//output
+  unsigned long time;	//millis() of the activation
+};
+#endif
+
+#if defined(Z21SYSINFO)
+#define z21SysInfoMin 250			//default: min. ms zwischen zwei Meldungen
+#define z21SysInfoMax 5000			//default: max. ms ohne Meldung
+#define z21SysInfoBandCurrent 50	//default: mA Änderung (gefiltert) für eine Meldung
+#define z21SysInfoBandVoltage 500	//default: mV Änderung für eine Meldung
+#define z21SysInfoBandTemp 2		//°C Änderung für eine Meldung
+#define z21SysInfoFilter 3			//FilteredMainCurrent: je Messwert 1/2^n des neuen Wertes
+
+struct TypeZ21SysInfo {
+  uint16_t current;		//mA, last sample
+  uint32_t filtered;	//mA << z21SysInfoFilter
+  uint16_t voltage;		//mV
+  uint16_t temp;		//°C
+  byte stateEx;			//CentralStateEx
+  bool valid;			//a sample is there
+  uint16_t minTime;		//setSystemInfoRate
+  uint16_t maxTime;
+  uint16_t bandCurrent;
+  uint16_t bandVoltage;
+  uint16_t sentCurrent;	//values of the last LAN_SYSTEMSTATE_DATACHANGED to all
+  uint16_t sentVoltage;
+  uint16_t sentTemp;
+  byte sentState;
+  byte sentStateEx;
+  unsigned long sentTime;	//millis()
+};
+#endif
+
+#if defined(Z21PERSIST)
+//State inside the store of the sketch (notifyz21PersistWrite/Read), each block: CRC (2 Byte) + data:
+#define z21PersistVersion 0x01
+#define z21PersistData 16			//Byte Daten je Block
+#define z21PersistBlock (2 + z21PersistData)
+#if !defined(z21PersistInterval)
+#define z21PersistInterval 1000	//min. ms zwischen zwei geschriebenen Blöcken (Verschleiß EEPROM/Flash)
+#endif
+#define z21PersistScan 8			//max. geprüfte Blöcke je tick()
+#if defined(Z21STATE)
+#define z21PersistTrnt (z21StateTrntMAX / 8 / z21PersistData)	//Blöcke Weichen
+#define z21PersistBlocks (1 + z21clientMAX + z21StateLocoMAX + z21PersistTrnt)	//Header, Clients, Loks, Weichen
+#else
+#define z21PersistTrnt 0
+#define z21PersistBlocks (1 + z21clientMAX)	//Header, Clients
+#endif
+#define z21PersistSize ((uint16_t) z21PersistBlocks * z21PersistBlock)	//Byte im Speicher des Sketch
+#endif
+
+//DCC Speed Steps
+#define DCCSTEP14	0x01
+#define DCCSTEP28	0x02
+#define DCCSTEP128	0x03
+
+struct TypeActIP {
+  byte client;    // Byte client
+  unsigned long BCFlag;  //BoadCastFlag - see Z21type.h
+  byte time;  //Zeit
+  uint16_t adr;		//Loco control Adr
+  uint32_t ip;		//IPv4 of the endpoint (getClient)
+  uint16_t port;	//UDP port of the endpoint, 0 = no endpoint
+};
+
+//Type of a CV request:
+#define z21CVReqRead		0x01	//Service Mode read
+#define z21CVReqWrite		0x02	//Service Mode write
+#define z21CVReqPOMRead		0x03	//POM read byte
+#define z21CVReqPOMACCRead	0x04	//POM accessory read byte
+#define z21CVReqStarted		0x80	//DCC is working on this request
+
+struct TypeCVReq {
+  byte type;		//z21CVReq..., 0 = unused
+  uint16_t adr;		//Loco or accessory Adr, 0 = Service Mode
+  uint16_t cv;		//CV Adr
+  byte value;		//value for write
+  byte client[z21CVReqClientMAX];	//request clients, 0 = unused
+  unsigned long time;	//start time of the request
+};
+
+//Type of a DCC command for the notify:
+#define z21EventRailPower		0x01	//data[0] = state
+#define z21EventLocoSpeed		0x02	//data[0] = speed, data[1] = steps
+#define z21EventLocoFkt			0x03	//data[0] = type, data[1] = fkt
+#define z21EventLocoFktGroup	0x04	//data[0] = DB0 of the group, data[1] = fkt
+#define z21EventLocoFktExt		0x05	//data[0] = low, data[1] = high
+#define z21EventAccessory		0x06	//data[0] = state, data[1] = active
+#define z21EventExtAccessory	0x07	//data[0] = state
+#define z21EventPOMWriteByte	0x08	//cv, data[0] = value
+#define z21EventPOMWriteBit		0x09	//cv, data[0] = value
+#define z21EventPOMACCWriteByte	0x0A	//cv, data[0] = value
+#define z21EventPOMACCWriteBit	0x0B	//cv, data[0] = value
+#define z21EventCVRead			0x0C	//cv
+#define z21EventCVWrite			0x0D	//cv, data[0] = value
+#define z21EventPOMReadByte		0x0E	//cv
+#define z21EventPOMACCReadByte	0x0F	//cv
+
+struct TypeZ21Event {
+  byte type;		//z21Event...
+  byte data[2];
+  uint16_t adr;		//Loco or accessory Adr
+  uint16_t cv;		//CV Adr
+};
+
+//Result of the programming (setCVReturn, setCVNack...):
+#define z21CVResultReturn	0x01	//cv, value
+#define z21CVResultNack		0x02
+#define z21CVResultNackSC	0x03
+#define z21CVResultPOM		0x04	//adr, cv, value
+#define z21CVResultPOMAny	0x05	//cv, value, adr of the request
+
+struct TypeZ21CVResult {
+  byte type;		//z21CVResult...
+  byte value;
+  uint16_t adr;
+  uint16_t cv;
+};
+
+#if defined(Z21STATS)
+#define z21StatHistMAX 16	//Histogram log2 µs: [0] = 0µs, [1] = 1µs, [2] = 2-3µs, ... [15] >= 16ms
+#define z21StatDirect 32	//txDatagrams/txBytes: direct to a client (not a BC)
+
+struct TypeZ21Stats {
+  uint32_t rxHeader[256];	//received messages per Header
+  uint32_t rxXHeader[256];	//received LAN_X messages per X-Header
+  uint32_t txDatagrams[33];	//sent datagrams per BC class (Bit of the Z21 BC-Flag) or z21StatDirect
+  uint32_t txBytes[33];		//sent bytes per BC class (Bit of the Z21 BC-Flag) or z21StatDirect
+  uint32_t fanout[z21clientMAX+1];	//number of clients for one message
+  uint32_t receiveTime[z21StatHistMAX];	//time inside receive()
+  uint32_t sendTime[z21StatHistMAX];	//time inside EthSend()
+  uint32_t clientRx[z21clientMAX];	//received messages per client slot
+  uint32_t clientTime[z21clientMAX];	//µs inside receive() per client slot
+  uint32_t rxUnknown;		//unknown commands
+  uint32_t eventLost;		//DCC commands lost, event queue was full (Z21EVENTQUEUE)
+  uint32_t sendReplaced;	//queued state messages replaced by a newer one (Z21SENDQUEUE)
+  uint32_t sendLost;		//messages lost, client queue was full (Z21SENDQUEUE)
+  uint32_t accCollapsed;	//turnout commands replaced by a newer one to the same Adr (Z21ACCQUEUE)
+  uint32_t accLost;			//turnout commands lost, queue was full (Z21ACCQUEUE)
+  uint32_t accSettle;		//ms of the last route, until the last coil is off (Z21ACCQUEUE)
+};
+#endif
+
+//Direction of a message (trace record and capture):
+#define z21TraceRX		0x01	//received from the client
+#define z21TraceTX		0x02	//send only to the client
+#define z21TraceBC		0x03	//send as BC, client is excluded
+
+#if defined(Z21TRACE)
+#define z21TraceMAX 32		//Anzahl Einträge im Ringspeicher (2^n!)
+#define z21TraceData 8		//gespeicherte Bytes je Nachricht (nach dem Header)
+
+struct TypeZ21Trace {
+  unsigned long time;	//micros()
+  unsigned int seq;		//write sequence of the record
+  byte client;
+  byte dir;				//z21TraceRX, z21TraceTX or z21TraceBC
+  uint16_t len;			//DataLen of the message
+  uint16_t header;
+  byte data[z21TraceData];	//first bytes after the header
+};
+#endif
+
+struct TypeExtACC {
+  uint16_t adr;		//RCN-213 Adr (z21ExtAccFree = unused)
+  byte state;		//last aspect
+};
+
+// library interface description
+template <class Handler>
+class z21Base
+#if defined(Z21STATE)
+	: public z21StateListener
+#endif
+{
+  // user-accessible "public" interface
+  public:
+	z21Base(void);	//Constuctor
+
+	void receive(uint8_t client, uint8_t *packet);				//Prüfe auf neue Ethernet Daten
+	
+	uint8_t getClient(uint32_t ip, uint16_t port);	//client of the UDP endpoint (IPv4, port), 0 if full
+	bool getEndpoint(uint8_t client, uint32_t &ip, uint16_t &port);	//endpoint of the client for notifyz21EthSend
+	
+	void setPower(byte state);		//Zustand Gleisspannung Melden
+	byte getPower();		//Zusand Gleisspannung ausgeben
+	
+	void setCVPOMBYTE (uint16_t CVAdr, uint8_t value);	//POM write byte return
+	void setCVPOMBYTE (uint16_t Adr, uint16_t CVAdr, uint8_t value);	//POM read byte return for the loco/accessory
+	
+	void setLocoStateExt (int Adr);	//send Loco state to BC
+	unsigned long getz21BcFlag (uint16_t flag);	//Convert EEPROM stored flag back into a Z21 Flag
+	
+	void setS88Data(byte *data);	//return state of S88 sensors
+
+	#if !defined(Z21NOLOCONET)
+	void setLNDetector(uint8_t client, byte *data, byte DataLen);	//return state from LN detector
+	bool setLNMessage(byte *data, byte DataLen, byte bcType, bool TX);	//return LN Message
+	bool setLNMessage(byte *data, byte DataLen, bool TX);	//return LN Message, BC by opcode class
+	#endif
+	
+	#if !defined(Z21NOCAN)
+	void setCANDetector(uint16_t NID, uint16_t Adr, uint8_t port, uint8_t typ, uint16_t v1, uint16_t v2); //state from CAN detector
+	#endif
+
+	void setTrntInfo(uint16_t Adr, bool State); //Return the state of accessory
+	
+	void setExtACCInfo(uint16_t Adr, byte State, byte Status = 0x00);	//Return EXT Accessory INFO (only on change)
+	
+	void setCVReturn (uint16_t CV, uint8_t value);	//Return CV Value for Programming
+	void setCVNack();	//Return no ACK from Decoder
+	void setCVNackSC();	//Return Short while Programming
+	
+	void sendSystemInfo(byte client, uint16_t maincurrent, uint16_t mainvoltage, uint16_t temp); 	//Send to all clients that request via BC the System Information
+	
+	#if defined(Z21SYSINFO)
+	void setSystemInfo(uint16_t maincurrent, uint16_t mainvoltage, uint16_t temp, byte stateEx = 0x00);	//sample at any rate, tick() inform the clients
+	void setSystemInfoRate(uint16_t minTime, uint16_t maxTime, uint16_t bandCurrent = z21SysInfoBandCurrent, uint16_t bandVoltage = z21SysInfoBandVoltage);	//ms, mA, mV
+	#endif
+	
+	void tick();	//call inside loop() - timeouts and client activity
+	
+	#if defined(Z21PERSIST)
+	bool begin();	//call inside setup() - restore the stored state, false if there is no valid state
+	#endif
+	
+	#if defined(Z21ACCQUEUE)
+	void setAccPulse(uint16_t pulse, byte active = z21AccActive);	//ms of a coil, max. active coils at once
+	unsigned long getAccSettle();	//ms of the last route: first command until the last coil is off
+	#endif
+	
+	#if defined(Z21STATE)
+	z21StateClass &getState();	//state tables, read from any task without lock
+	void attach(z21StateClass &core);	//share the state with other z21Class (same task!)
+	
+		//changes of the other Front-Ends, called by the shared state:
+	void statePower(byte state);
+	void stateLoco(uint16_t Adr);
+	void stateTrnt(uint16_t Adr, bool State);
+	void stateExtACC(uint16_t Adr, byte State, byte Status);
+	void stateS88(byte *data);
+	#endif
+	
+	#if defined(Z21EVENTQUEUE)
+	//all other functions only from the task that call receive(), setCVReturn, setCVNack, setCVNackSC and setCVPOMBYTE
+	//also from the DCC task (tick() inform the clients)!
+	byte poll();	//call inside the DCC task - notify all stored DCC commands, return the number
+	#endif
+	
+	#if defined(Z21STATS)
+	const TypeZ21Stats *getStats();	//read the statistic
+	void clearStats();		//reset the statistic
+	#endif
+	
+	#if defined(Z21TRACE)
+	bool traceRead(TypeZ21Trace &rec);	//get the oldest trace record
+	void traceDrain(Print &out);		//print all trace records
+	#endif
+	
+  // library-accessible "private" interface
+  private:
+
+		//Variables:
+	byte Railpower;				//state of the railpower
+	long z21IPpreviousMillis;        // will store last time of IP decount updated  
+	TypeActIP ActIP[z21clientMAX];    //Speicherarray für IPs
+	byte TXBuffer[z21TXBufferSize];	//collect messages for one client into one datagram
+	uint16_t TXBufferLen;
+	byte TXBufferClient;	//0 = no collecting
+	
+		//Functions:
+	void returnLocoStateFull (byte client, uint16_t Adr, bool bc, bool pending = false, byte db0 = 0, byte db3 = 0);  //Antwort auf Statusabfrage
+								//pending: LAN_X_SET_LOCO (DB0, DB3) not yet at the DCC task (Z21EVENTQUEUE)
+	void EthSend (byte client, unsigned int DataLen, unsigned int Header, byte *dataString, boolean withXOR, unsigned long BC);
+	#if !defined(Z21NOLOCONET)
+	void EthSendLN (byte client, byte DataLen, unsigned int Header, byte *dataString);	//LocoNet tunnel to the matching clients
+	#endif
+	void EthBufferBegin (byte client);	//collect all following messages to this client
+	void EthBufferFlush ();		//send the collected messages
+	void EthBufferEnd ();		//send and stop collecting
+	void returnPower (byte client);	//power state to one client or (client = 0) to all
+	void returnSystemInfo (byte client, uint16_t maincurrent, uint16_t filtered, uint16_t mainvoltage, uint16_t temp, byte stateEx);	//LAN_SYSTEMSTATE_DATACHANGED
+	void returnTrntInfo (uint16_t Adr, bool State);	//turnout state to all
+	void sendClientSnapshot (byte client, unsigned long BCFlag);	//inform a new client
+	uint16_t getLocalBcFlag (unsigned long flag);  //Convert Z21 LAN BC flag to EEPROM stored flag
+	void clearIP (byte pos);		//delete the stored client
+	void clearIPSlots();			//delete all stored clients
+	void clearIPSlot(byte client);	//delete a client
+	unsigned long addIPToSlot (byte client, unsigned long BCFlag);
+	void addNewIPSlot (byte Slot, byte client);	//new client inside a free slot
+	
+	byte EndpointHash[z21EndpointHashMAX];	//Slot + 1 of the endpoint, 0 = free
+	uint16_t endpointHash (uint32_t ip, uint16_t port);	//first place inside the table
+	void endpointRebuild ();	//fill the table with all endpoints
+	
+	void setOtherSlotBusy(byte slot);
+	void addBusySlot (byte client, uint16_t adr);
+	void reqLocoBusy (uint16_t adr);
+	
+	byte getEEPROMBCFlagIndex();		//return the length of BC-Flag store
+	void setEEPROMBCFlag(byte IPHash, unsigned long BCFlag);		//add BC-Flag to store
+	unsigned long findEEPROMBCFlag(byte IPHash);		//read the BC-Flag for this client
+	
+	#if defined(Z21STATS)
+	TypeZ21Stats Stats;
+	void returnStats(byte client, byte page);	//LAN_DIAG_GETSTATS
+	#endif
+	
+	#if defined(Z21SENDQUEUE)
+	TypeZ21SendQueue SendQueue[z21clientMAX];	//for each client slot
+	void queueSend(byte slot, byte *data);	//send or queue the message for the client
+	void queueFlush(byte slot);		//send while the client is ready
+	uint32_t queueKey(byte *data);	//state messages with the same key replace each other
+	byte queuePrio(byte *data);		//z21Prio... of the message
+	void queueRemove(byte slot, byte pos);	//delete the message from the queue
+	#endif
+	
+	#if defined(Z21PERSIST)
+	uint16_t PersistCRC[z21PersistBlocks];	//CRC of the stored blocks
+	uint16_t PersistNext;		//next block to check
+	unsigned long PersistTime;	//millis() of the last write
+	void persistTick();		//store the next changed block
+	void persistBlock(uint16_t block, byte *data);		//data of the block
+	void persistRestore(uint16_t block, byte *data);	//restore the data of the block
+	uint16_t persistCRC(uint16_t block, byte *data);	//CRC-16 (CCITT) of block number and data
+	#endif
+	
+	#if defined(Z21SYSINFO)
+	TypeZ21SysInfo SysInfo;
+	void sysInfoRun();	//send on a change of the state, the deadband or after the max. interval
+	#endif
+	
+	#if defined(Z21ACCQUEUE)
+	TypeZ21AccCmd AccQueue[z21AccQueueMAX];	//waiting commands, AccQueue[0] is the oldest
+	byte AccCount;
+	TypeZ21AccCmd AccActive[z21AccActiveMAX];	//coils that are on
+	byte AccActiveCount;
+	byte AccActiveLimit;
+	uint16_t AccPulse;
+	unsigned long AccStart;		//millis() of the first command of the route
+	unsigned long AccSettle;	//ms of the last route
+	bool AccRoute;			//commands are waiting or coils are on
+	void accQueue(uint16_t Adr, byte state);	//add or replace the command
+	void accRun();		//switch coils off after the pulse, start the next commands
+	#endif
+	
+	#if defined(Z21TRACE)
+	TypeZ21Trace Trace[z21TraceMAX];	//ring of the last messages
+	unsigned int TraceHead;		//next record to write
+	unsigned int TraceTail;		//next record to read
+	unsigned long TraceLost;	//overwritten records before read
+	void traceAdd(byte client, byte dir, byte *data);	//add message to the ring
+	#endif
+	
+	bool addEvent(byte type, uint16_t Adr, byte data0, byte data1 = 0, uint16_t CV = 0);	//DCC command from receive(), false if the queue is full
+	void callEvent(const TypeZ21Event &ev);	//notify the DCC command
+	#if defined(Z21EVENTQUEUE)
+	TypeZ21Event Event[z21EventMAX];	//single producer (receive) single consumer (poll) ring
+	byte EventHead;		//written only by receive()
+	byte EventTail;		//written only by poll()
+	byte EventPower;	//latest z21EventRailPower, never lost, poll() notify it first
+	byte EventPowerSeq;		//written only by receive()
+	byte EventPowerDone;	//written only by poll()
+	TypeZ21CVResult CVResult[z21CVResultMAX];	//single producer (DCC task) single consumer (tick) ring
+	byte CVResultHead;	//written only by the DCC task
+	byte CVResultTail;	//written only by tick()
+	#endif
+	void cvResult(byte type, uint16_t Adr, uint16_t CV, byte value);	//setCV...: now or (Z21EVENTQUEUE) by tick()
+	void returnCVResult(byte type, uint16_t Adr, uint16_t CV, byte value);	//answer the request clients
+	
+	#if defined(Z21STATE)
+	z21StateClass OwnState;	//power, locos and turnouts of this instance
+	z21StateClass *State;	//OwnState or the shared state
+	#endif
+	
+	TypeCVReq CVReq[z21CVReqMAX];	//pending CV requests, CVReq[0] is the oldest
+	void addCVReq(byte client, byte type, uint16_t Adr, uint16_t CV, byte value);	//new CV request
+	void startCVReq();		//notify DCC about the oldest CV request
+	void removeCVReq(byte pos);	//delete the request and start the next one
+	byte findCVReq(byte type, uint16_t Adr, uint16_t CV);	//return pos of the request or z21CVReqMAX
+	void returnCVReq(byte pos, unsigned int DataLen, byte *data);	//send result to the request clients
+	
+	TypeExtACC ExtACC[z21ExtAccMAX];	//for LAN_X_GET_EXT_ACCESSORY_INFO
+	void clearExtACC();		//delete all stored aspects
+	byte findExtACC(uint16_t Adr);	//return slot of Adr or z21ExtAccMAX
+	bool storeExtACC(uint16_t Adr, byte State);	//store aspect, return true if changed
+	void returnExtACCInfo(byte client, uint16_t Adr, byte State, byte Status);
+};
+
+#if defined (__cplusplus)
+	extern "C" {
+#endif
+
+	extern void notifyz21getSystemInfo(uint8_t client) __attribute__((weak));
+	
+	extern void notifyz21EthSend(uint8_t client, uint8_t *data) __attribute__((weak));
+	extern void notifyz21EthSendDatagram(uint8_t client, uint8_t *data, uint16_t length) __attribute__((weak));	//more then one message in data
+	extern void notifyz21Capture(uint8_t dir, uint8_t client, uint8_t *data) __attribute__((weak));	//each received and sent message, see z21capture.h
+	extern bool notifyz21EthReady(uint8_t client) __attribute__((weak));	//client can take a message now (Z21SENDQUEUE)
+	extern void notifyz21PersistWrite(uint16_t pos, uint8_t *data, uint8_t len) __attribute__((weak));	//store a block (Z21PERSIST)
+	extern bool notifyz21PersistRead(uint16_t pos, uint8_t *data, uint8_t len) __attribute__((weak));	//read a block, false if not possible
+
+	extern void notifyz21LNdetector(uint8_t client, uint8_t typ, uint16_t Adr) __attribute__((weak));
+	extern uint8_t notifyz21LNdispatch(uint16_t Adr) __attribute__((weak));
+	extern void notifyz21LNSendPacket(uint8_t *data, uint8_t length) __attribute__((weak));
+	
+	extern void notifyz21CANdetector(uint8_t client, uint8_t typ, uint16_t ID) __attribute__((weak));
+	
+	extern void notifyz21RailPower(uint8_t State ) __attribute__((weak));
+	
+	extern void notifyz21CVREAD(uint8_t cvAdrMSB, uint8_t cvAdrLSB) __attribute__((weak));
+	extern void notifyz21CVWRITE(uint8_t cvAdrMSB, uint8_t cvAdrLSB, uint8_t value) __attribute__((weak));
+	extern void notifyz21CVPOMWRITEBYTE(uint16_t Adr, uint16_t cvAdr, uint8_t value) __attribute__((weak));
+	extern void notifyz21CVPOMWRITEBIT(uint16_t Adr, uint16_t cvAdr, uint8_t value) __attribute__((weak));
+	extern void notifyz21CVPOMREADBYTE(uint16_t Adr, uint16_t cvAdr) __attribute__((weak));
+	extern void notifyz21CVPOMACCWRITEBYTE(uint16_t Adr, uint16_t cvAdr, uint8_t value) __attribute__((weak));
+	extern void notifyz21CVPOMACCWRITEBIT(uint16_t Adr, uint16_t cvAdr, uint8_t value) __attribute__((weak));
+	extern void notifyz21CVPOMACCREADBYTE(uint16_t Adr, uint16_t cvAdr) __attribute__((weak));
+	
+	extern uint8_t notifyz21AccessoryInfo(uint16_t Adr) __attribute__((weak));
+	extern void notifyz21Accessory(uint16_t Adr, bool state, bool active) __attribute__((weak));
+	extern void notifyz21ExtAccessory(uint16_t Adr, byte state) __attribute__((weak));
+		
+	extern void notifyz21LocoState(uint16_t Adr, uint8_t data[]) __attribute__((weak));
+	extern void notifyz21LocoFkt(uint16_t Adr, uint8_t type, uint8_t fkt) __attribute__((weak));
+	extern void notifyz21LocoFkt0to4(uint16_t Adr, uint8_t fkt) __attribute__((weak));
+	extern void notifyz21LocoFkt5to8(uint16_t Adr, uint8_t fkt) __attribute__((weak));
+	extern void notifyz21LocoFkt9to12(uint16_t Adr, uint8_t fkt) __attribute__((weak));
+	extern void notifyz21LocoFkt13to20(uint16_t Adr, uint8_t fkt) __attribute__((weak));
+	extern void notifyz21LocoFkt21to28(uint16_t Adr, uint8_t fkt) __attribute__((weak));
+	extern void notifyz21LocoFkt29to36(uint16_t Adr, uint8_t fkt) __attribute__((weak));
+	extern void notifyz21LocoFkt37to44(uint16_t Adr, uint8_t fkt) __attribute__((weak));
+	extern void notifyz21LocoFkt45to52(uint16_t Adr, uint8_t fkt) __attribute__((weak));
+	extern void notifyz21LocoFkt53to60(uint16_t Adr, uint8_t fkt) __attribute__((weak));
+	extern void notifyz21LocoFkt61to68(uint16_t Adr, uint8_t fkt) __attribute__((weak));
+	extern void notifyz21LocoFktExt(uint16_t Adr, uint8_t low, uint8_t high) __attribute__((weak));
+	extern void notifyz21LocoSpeed(uint16_t Adr, uint8_t speed, uint8_t steps) __attribute__((weak));
+	
+	extern void notifyz21S88Data(uint8_t gIndex) __attribute__((weak));	//return last state S88 Data for the Client!
+	
+	extern uint16_t notifyz21Railcom() __attribute__((weak));	//return global Railcom Adr
+	
+	extern void notifyz21UpdateConf() __attribute__((weak)); //information for DCC via EEPROM (RailCom, ProgMode,...)
+	
+	extern uint8_t notifyz21ClientHash(uint8_t client) __attribute__((weak));
+
+#if defined (__cplusplus)
+}
+#endif
+
+//--------------------------------------------------------------
+//Handler without any hook: derive from this and add only the used hooks (same name without "notifyz21").
+//A hook with has...() must also return true with has...(), else the library don't use it.
+struct z21NoHandler {
+	static inline void getSystemInfo(uint8_t client) {}
+	static inline void EthSend(uint8_t client, uint8_t *data) {}
+	static inline bool hasEthSendDatagram() { return false; }
+	static inline void EthSendDatagram(uint8_t client, uint8_t *data, uint16_t length) {}
+	static inline void Capture(uint8_t dir, uint8_t client, uint8_t *data) {}
+	static inline bool hasEthReady() { return false; }
+	static inline bool EthReady(uint8_t client) { return true; }
+	static inline bool hasPersist() { return false; }
+	static inline void PersistWrite(uint16_t pos, uint8_t *data, uint8_t len) {}
+	static inline bool PersistRead(uint16_t pos, uint8_t *data, uint8_t len) { return false; }
+	static inline void LNdetector(uint8_t client, uint8_t typ, uint16_t Adr) {}
+	static inline bool hasLNdispatch() { return false; }
+	static inline uint8_t LNdispatch(uint16_t Adr) { return 0xFF; }
+	static inline void LNSendPacket(uint8_t *data, uint8_t length) {}
+	static inline void CANdetector(uint8_t client, uint8_t typ, uint16_t ID) {}
+	static inline void RailPower(uint8_t State) {}
+	static inline bool hasCVREAD() { return false; }
+	static inline void CVREAD(uint8_t cvAdrMSB, uint8_t cvAdrLSB) {}
+	static inline bool hasCVWRITE() { return false; }
+	static inline void CVWRITE(uint8_t cvAdrMSB, uint8_t cvAdrLSB, uint8_t value) {}
+	static inline void CVPOMWRITEBYTE(uint16_t Adr, uint16_t cvAdr, uint8_t value) {}
+	static inline void CVPOMWRITEBIT(uint16_t Adr, uint16_t cvAdr, uint8_t value) {}
+	static inline bool hasCVPOMREADBYTE() { return false; }
+	static inline void CVPOMREADBYTE(uint16_t Adr, uint16_t cvAdr) {}
+	static inline void CVPOMACCWRITEBYTE(uint16_t Adr, uint16_t cvAdr, uint8_t value) {}
+	static inline void CVPOMACCWRITEBIT(uint16_t Adr, uint16_t cvAdr, uint8_t value) {}
+	static inline bool hasCVPOMACCREADBYTE() { return false; }
+	static inline void CVPOMACCREADBYTE(uint16_t Adr, uint16_t cvAdr) {}
+	static inline bool hasAccessoryInfo() { return false; }
+	static inline uint8_t AccessoryInfo(uint16_t Adr) { return 0; }
+	static inline void Accessory(uint16_t Adr, bool state, bool active) {}
+	static inline void ExtAccessory(uint16_t Adr, byte state) {}
+	static inline bool hasLocoState() { return false; }
+	static inline void LocoState(uint16_t Adr, uint8_t data[]) {}
+	static inline void LocoFkt(uint16_t Adr, uint8_t type, uint8_t fkt) {}
+	static inline void LocoFkt0to4(uint16_t Adr, uint8_t fkt) {}
+	static inline void LocoFkt5to8(uint16_t Adr, uint8_t fkt) {}
+	static inline void LocoFkt9to12(uint16_t Adr, uint8_t fkt) {}
+	static inline void LocoFkt13to20(uint16_t Adr, uint8_t fkt) {}
+	static inline void LocoFkt21to28(uint16_t Adr, uint8_t fkt) {}
+	static inline void LocoFkt29to36(uint16_t Adr, uint8_t fkt) {}
+	static inline void LocoFkt37to44(uint16_t Adr, uint8_t fkt) {}
+	static inline void LocoFkt45to52(uint16_t Adr, uint8_t fkt) {}
+	static inline void LocoFkt53to60(uint16_t Adr, uint8_t fkt) {}
+	static inline void LocoFkt61to68(uint16_t Adr, uint8_t fkt) {}
+	static inline void LocoFktExt(uint16_t Adr, uint8_t low, uint8_t high) {}
+	static inline void LocoSpeed(uint16_t Adr, uint8_t speed, uint8_t steps) {}
+	static inline void S88Data(uint8_t gIndex) {}
+	static inline bool hasRailcom() { return false; }
+	static inline uint16_t Railcom() { return 0; }
+	static inline void UpdateConf() {}
+	static inline bool hasClientHash() { return false; }
+	static inline uint8_t ClientHash(uint8_t client) { return 0; }
+};
+
+//Handler for the weak notify functions:
+struct z21WeakHandler {
+	static inline void getSystemInfo(uint8_t client) { if (notifyz21getSystemInfo) notifyz21getSystemInfo(client); }
+	static inline void EthSend(uint8_t client, uint8_t *data) { if (notifyz21EthSend) notifyz21EthSend(client, data); }
+	static inline bool hasEthSendDatagram() { return notifyz21EthSendDatagram != NULL; }
+	static inline void EthSendDatagram(uint8_t client, uint8_t *data, uint16_t length) { if (notifyz21EthSendDatagram) notifyz21EthSendDatagram(client, data, length); }
+	static inline void Capture(uint8_t dir, uint8_t client, uint8_t *data) { if (notifyz21Capture) notifyz21Capture(dir, client, data); }
+	static inline bool hasEthReady() { return notifyz21EthReady != NULL; }
+	static inline bool EthReady(uint8_t client) { return notifyz21EthReady ? notifyz21EthReady(client) : true; }
+	static inline bool hasPersist() { return notifyz21PersistWrite != NULL; }
+	static inline void PersistWrite(uint16_t pos, uint8_t *data, uint8_t len) { if (notifyz21PersistWrite) notifyz21PersistWrite(pos, data, len); }
+	static inline bool PersistRead(uint16_t pos, uint8_t *data, uint8_t len) { return notifyz21PersistRead ? notifyz21PersistRead(pos, data, len) : false; }
+	static inline void LNdetector(uint8_t client, uint8_t typ, uint16_t Adr) { if (notifyz21LNdetector) notifyz21LNdetector(client, typ, Adr); }
+	static inline bool hasLNdispatch() { return notifyz21LNdispatch != NULL; }
+	static inline uint8_t LNdispatch(uint16_t Adr) { return notifyz21LNdispatch ? notifyz21LNdispatch(Adr) : 0xFF; }
+	static inline void LNSendPacket(uint8_t *data, uint8_t length) { if (notifyz21LNSendPacket) notifyz21LNSendPacket(data, length); }
+	static inline void CANdetector(uint8_t client, uint8_t typ, uint16_t ID) { if (notifyz21CANdetector) notifyz21CANdetector(client, typ, ID); }
+	static inline void RailPower(uint8_t State) { if (notifyz21RailPower) notifyz21RailPower(State); }
+	static inline bool hasCVREAD() { return notifyz21CVREAD != NULL; }
+	static inline void CVREAD(uint8_t cvAdrMSB, uint8_t cvAdrLSB) { if (notifyz21CVREAD) notifyz21CVREAD(cvAdrMSB, cvAdrLSB); }
+	static inline bool hasCVWRITE() { return notifyz21CVWRITE != NULL; }
+	static inline void CVWRITE(uint8_t cvAdrMSB, uint8_t cvAdrLSB, uint8_t value) { if (notifyz21CVWRITE) notifyz21CVWRITE(cvAdrMSB, cvAdrLSB, value); }
+	static inline void CVPOMWRITEBYTE(uint16_t Adr, uint16_t cvAdr, uint8_t value) { if (notifyz21CVPOMWRITEBYTE) notifyz21CVPOMWRITEBYTE(Adr, cvAdr, value); }
+	static inline void CVPOMWRITEBIT(uint16_t Adr, uint16_t cvAdr, uint8_t value) { if (notifyz21CVPOMWRITEBIT) notifyz21CVPOMWRITEBIT(Adr, cvAdr, value); }
+	static inline bool hasCVPOMREADBYTE() { return notifyz21CVPOMREADBYTE != NULL; }
+	static inline void CVPOMREADBYTE(uint16_t Adr, uint16_t cvAdr) { if (notifyz21CVPOMREADBYTE) notifyz21CVPOMREADBYTE(Adr, cvAdr); }
+	static inline void CVPOMACCWRITEBYTE(uint16_t Adr, uint16_t cvAdr, uint8_t value) { if (notifyz21CVPOMACCWRITEBYTE) notifyz21CVPOMACCWRITEBYTE(Adr, cvAdr, value); }
+	static inline void CVPOMACCWRITEBIT(uint16_t Adr, uint16_t cvAdr, uint8_t value) { if (notifyz21CVPOMACCWRITEBIT) notifyz21CVPOMACCWRITEBIT(Adr, cvAdr, value); }
+	static inline bool hasCVPOMACCREADBYTE() { return notifyz21CVPOMACCREADBYTE != NULL; }
+	static inline void CVPOMACCREADBYTE(uint16_t Adr, uint16_t cvAdr) { if (notifyz21CVPOMACCREADBYTE) notifyz21CVPOMACCREADBYTE(Adr, cvAdr); }
+	static inline bool hasAccessoryInfo() { return notifyz21AccessoryInfo != NULL; }
+	static inline uint8_t AccessoryInfo(uint16_t Adr) { return notifyz21AccessoryInfo ? notifyz21AccessoryInfo(Adr) : 0; }
+	static inline void Accessory(uint16_t Adr, bool state, bool active) { if (notifyz21Accessory) notifyz21Accessory(Adr, state, active); }
+	static inline void ExtAccessory(uint16_t Adr, byte state) { if (notifyz21ExtAccessory) notifyz21ExtAccessory(Adr, state); }
+	static inline bool hasLocoState() { return notifyz21LocoState != NULL; }
+	static inline void LocoState(uint16_t Adr, uint8_t data[]) { if (notifyz21LocoState) notifyz21LocoState(Adr, data); }
+	static inline void LocoFkt(uint16_t Adr, uint8_t type, uint8_t fkt) { if (notifyz21LocoFkt) notifyz21LocoFkt(Adr, type, fkt); }
+	static inline void LocoFkt0to4(uint16_t Adr, uint8_t fkt) { if (notifyz21LocoFkt0to4) notifyz21LocoFkt0to4(Adr, fkt); }
+	static inline void LocoFkt5to8(uint16_t Adr, uint8_t fkt) { if (notifyz21LocoFkt5to8) notifyz21LocoFkt5to8(Adr, fkt); }
+	static inline void LocoFkt9to12(uint16_t Adr, uint8_t fkt) { if (notifyz21LocoFkt9to12) notifyz21LocoFkt9to12(Adr, fkt); }
+	static inline void LocoFkt13to20(uint16_t Adr, uint8_t fkt) { if (notifyz21LocoFkt13to20) notifyz21LocoFkt13to20(Adr, fkt); }
+	static inline void LocoFkt21to28(uint16_t Adr, uint8_t fkt) { if (notifyz21LocoFkt21to28) notifyz21LocoFkt21to28(Adr, fkt); }
+	static inline void LocoFkt29to36(uint16_t Adr, uint8_t fkt) { if (notifyz21LocoFkt29to36) notifyz21LocoFkt29to36(Adr, fkt); }
+	static inline void LocoFkt37to44(uint16_t Adr, uint8_t fkt) { if (notifyz21LocoFkt37to44) notifyz21LocoFkt37to44(Adr, fkt); }
+	static inline void LocoFkt45to52(uint16_t Adr, uint8_t fkt) { if (notifyz21LocoFkt45to52) notifyz21LocoFkt45to52(Adr, fkt); }
+	static inline void LocoFkt53to60(uint16_t Adr, uint8_t fkt) { if (notifyz21LocoFkt53to60) notifyz21LocoFkt53to60(Adr, fkt); }
+	static inline void LocoFkt61to68(uint16_t Adr, uint8_t fkt) { if (notifyz21LocoFkt61to68) notifyz21LocoFkt61to68(Adr, fkt); }
+	static inline void LocoFktExt(uint16_t Adr, uint8_t low, uint8_t high) { if (notifyz21LocoFktExt) notifyz21LocoFktExt(Adr, low, high); }
+	static inline void LocoSpeed(uint16_t Adr, uint8_t speed, uint8_t steps) { if (notifyz21LocoSpeed) notifyz21LocoSpeed(Adr, speed, steps); }
+	static inline void S88Data(uint8_t gIndex) { if (notifyz21S88Data) notifyz21S88Data(gIndex); }
+	static inline bool hasRailcom() { return notifyz21Railcom != NULL; }
+	static inline uint16_t Railcom() { return notifyz21Railcom ? notifyz21Railcom() : 0; }
+	static inline void UpdateConf() { if (notifyz21UpdateConf) notifyz21UpdateConf(); }
+	static inline bool hasClientHash() { return notifyz21ClientHash != NULL; }
+	static inline uint8_t ClientHash(uint8_t client) { return notifyz21ClientHash ? notifyz21ClientHash(client) : 0; }
+};
+
+typedef z21Base<z21WeakHandler> z21Class;	//build inside z21.cpp
+extern template class z21Base<z21WeakHandler>;
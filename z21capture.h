@@ -0,0 +1,55 @@
+/*
+  z21capture.h - binary capture of the Z21 LAN messages (record and replay)
+  Copyright (c) 2026 Philipp Gahtow  All right reserved.
+
+  Notice:
+	- record on the device with the hook notifyz21Capture, i.e. to a file on a SD card:
+		void notifyz21Capture(uint8_t dir, uint8_t client, uint8_t *data) {
+			z21CaptureWrite(file, dir, client, data);
+		}
+	- the hook is called inside receive() and EthSend(), a slow Print block the library!
+	- replay on a host PC with extras/z21replay
+
+  Format (all values Little Endian):
+	File header (8 Byte):	'Z' '2' '1' 'C', Version, 0, 0, 0
+	Record (8 Byte + Message):
+		uint32 time		micros() of the device
+		uint8  client	client of receive() or EthSend(), 0 = all
+		uint8  dir		z21TraceRX, z21TraceTX or z21TraceBC
+		uint16 length	length of the message
+		length Byte		message like the UDP data (with DataLen and Header)
+*/
+
+#ifndef z21capture_h
+#define z21capture_h
+
+#define z21CaptureVersion	0x01
+#define z21CaptureHeader	8	//Byte of the file header
+#define z21CaptureRecord	8	//Byte of a record without the message
+
+//--------------------------------------------------------------------------------------------
+//write the file header
+inline void z21CaptureBegin(Print &out) {
+	const uint8_t head[z21CaptureHeader] = {'Z', '2', '1', 'C', z21CaptureVersion, 0, 0, 0};
+	out.write(head, z21CaptureHeader);
+}
+
+//--------------------------------------------------------------------------------------------
+//write one message, length from the message (DataLen)
+inline void z21CaptureWrite(Print &out, uint8_t dir, uint8_t client, uint8_t *data) {
+	uint16_t length = word(data[1], data[0]);
+	uint32_t time = micros();
+	uint8_t rec[z21CaptureRecord];
+	rec[0] = time & 0xFF;
+	rec[1] = (time >> 8) & 0xFF;
+	rec[2] = (time >> 16) & 0xFF;
+	rec[3] = time >> 24;
+	rec[4] = client;
+	rec[5] = dir;
+	rec[6] = lowByte(length);
+	rec[7] = highByte(length);
+	out.write(rec, z21CaptureRecord);
+	out.write(data, length);
+}
+
+#endif
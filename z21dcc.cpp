@@ -0,0 +1,240 @@
+/*
+*****************************************************************************
+  *		z21dcc.cpp - DCC packets for the commands of the Z21 LAN protocol
+  *		Copyright (c) 2026 Philipp Gahtow  All right reserved.
+  *
+  *
+*****************************************************************************
+  * IMPORTANT:
+  *
+  * 	Please contact ROCO Inc. for more details.
+*****************************************************************************
+*/
+
+// include this library's description file
+#include <z21dcc.h>
+
+//--------------------------------------------------------------------------------------------
+//tables inside the flash on AVR:
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#define z21DCCFlash PROGMEM
+#define z21DCCRead(table, i) pgm_read_byte(&table[i])
+#else
+#define z21DCCFlash
+#define z21DCCRead(table, i) (table[i])
+#endif
+
+#define z21DCC4(f, i) f(i), f(i + 1), f(i + 2), f(i + 3)
+#define z21DCC16(f, i) z21DCC4(f, i), z21DCC4(f, i + 4), z21DCC4(f, i + 8), z21DCC4(f, i + 12)
+
+//28 speed steps: bit 4 is the lowest bit of the step (C), bits 0-3 the higher bits
+static constexpr byte z21DCCValue28(byte v) { return ((v & 0x0F) << 1) | ((v >> 4) & 0x01); }
+static constexpr byte z21DCCStep28(byte v) {
+	return z21DCCValue28(v) < 2 ? 0 : (z21DCCValue28(v) < 4 ? z21DCCEStop : z21DCCValue28(v) - 3);
+}
+static constexpr byte z21DCCByte28(byte s) { return s == 0 ? 0 : (((s + 3) >> 1) | (((s + 3) & 0x01) << 4)); }
+
+static constexpr byte Step28[32] z21DCCFlash = { z21DCC16(z21DCCStep28, 0), z21DCC16(z21DCCStep28, 16) };
+static constexpr byte Byte28[29] z21DCCFlash = { z21DCC16(z21DCCByte28, 0), z21DCC4(z21DCCByte28, 16),
+	z21DCC4(z21DCCByte28, 20), z21DCC4(z21DCCByte28, 24), z21DCCByte28(28) };
+
+static_assert(Step28[0x02] == 1 && Step28[0x12] == 2 && Step28[0x1F] == 28 && Step28[0x11] == z21DCCEStop, "28 speed steps");
+static_assert(Byte28[1] == 0x02 && Byte28[2] == 0x12 && Byte28[28] == 0x1F, "28 speed steps");
+
+//Z21 function group (DB0) -> DCC instruction, bits of fkt inside the instruction (0 = second byte):
+static constexpr byte FktGroup[][3] z21DCCFlash = {
+	{0x20, 0x80, 0x1F},		//F0 F4 F3 F2 F1
+	{0x21, 0xB0, 0x0F},		//F8 - F5
+	{0x22, 0xA0, 0x0F},		//F12 - F9
+	{0x23, 0xDE, 0x00},		//F13 - F20
+	{0x28, 0xDF, 0x00},		//F21 - F28
+	{0x29, 0xD8, 0x00},		//F29 - F36
+	{0x2A, 0xD9, 0x00},		//F37 - F44
+	{0x2B, 0xDA, 0x00},		//F45 - F52
+	{0x50, 0xDB, 0x00},		//F53 - F60
+	{0x51, 0xDC, 0x00}		//F61 - F68
+};
+
+//group of F13 - F68 in steps of 8 functions:
+static constexpr byte FktGroup8[7] z21DCCFlash = {0x23, 0x28, 0x29, 0x2A, 0x2B, 0x50, 0x51};
+
+//--------------------------------------------------------------------------------------------
+//address of the loco, return number of bytes (0 if not valid)
+static byte z21DCCAdr(byte *packet, uint16_t Adr) {
+	if (Adr < 128) {
+		packet[0] = Adr;	//0 = broadcast
+		return 1;
+	}
+	if (Adr > 10239)
+		return 0;
+	packet[0] = 0xC0 | (Adr >> 8);
+	packet[1] = Adr & 0xFF;
+	return 2;
+}
+
+//--------------------------------------------------------------------------------------------
+//address of an accessory decoder (9 bit) and the low bits of the second byte
+static byte z21DCCAccAdr(byte *packet, uint16_t decoder, byte low) {
+	if (decoder > 511)
+		return 0;
+	packet[0] = 0x80 | (decoder & 0x3F);
+	packet[1] = ((~decoder >> 2) & 0x70) | low;	//high bits are inverted
+	return 2;
+}
+
+//--------------------------------------------------------------------------------------------
+//add the error byte, return the full length
+static byte z21DCCEnd(byte *packet, byte len) {
+	if (len == 0)
+		return 0;
+	byte err = 0;
+	for (byte i = 0; i < len; i++)
+		err ^= packet[i];
+	packet[len] = err;
+	return len + 1;
+}
+
+//--------------------------------------------------------------------------------------------
+//POM instruction: 1110CCVV VVVVVVVV DDDDDDDD
+static byte z21DCCPOM(byte *packet, byte len, byte cc, uint16_t cvAdr, uint8_t value) {
+	if (len == 0 || cvAdr > 1023)
+		return 0;
+	packet[len] = 0xE0 | (cc << 2) | (cvAdr >> 8);
+	packet[len + 1] = cvAdr & 0xFF;
+	packet[len + 2] = value;
+	return z21DCCEnd(packet, len + 3);
+}
+
+//*********************************************************************************************
+//Loco:
+
+//--------------------------------------------------------------------------------------------
+byte z21DCCLocoSpeed(byte *packet, uint16_t Adr, uint8_t speed, uint8_t steps) {
+	byte len = z21DCCAdr(packet, Adr);
+	if (len == 0)
+		return 0;
+	if (steps == 14 || steps == 28)		//01DCSSSS, Z21 R in bit 7
+		packet[len++] = 0x40 | ((speed >> 2) & 0x20) | (speed & 0x1F);
+	else {	//128 speed steps
+		packet[len++] = 0x3F;
+		packet[len++] = speed;
+	}
+	return z21DCCEnd(packet, len);
+}
+
+//--------------------------------------------------------------------------------------------
+byte z21DCCLocoFktGroup(byte *packet, uint16_t Adr, uint8_t group, uint8_t fkt) {
+	byte len = z21DCCAdr(packet, Adr);
+	if (len == 0)
+		return 0;
+	for (byte i = 0; i < sizeof(FktGroup) / sizeof(FktGroup[0]); i++) {
+		if (z21DCCRead(FktGroup[i], 0) == group) {
+			byte mask = z21DCCRead(FktGroup[i], 2);
+			if (mask != 0)
+				packet[len++] = z21DCCRead(FktGroup[i], 1) | (fkt & mask);
+			else {
+				packet[len++] = z21DCCRead(FktGroup[i], 1);
+				packet[len++] = fkt;
+			}
+			return z21DCCEnd(packet, len);
+		}
+	}
+	return 0;	//unknown group
+}
+
+//--------------------------------------------------------------------------------------------
+byte z21DCCFktGroup(uint8_t fkt) {
+	if (fkt <= 4)
+		return 0x20;
+	if (fkt <= 8)
+		return 0x21;
+	if (fkt <= 12)
+		return 0x22;
+	if (fkt <= 68)
+		return z21DCCRead(FktGroup8, (fkt - 13) >> 3);
+	return 0;
+}
+
+//*********************************************************************************************
+//Accessory:
+
+//--------------------------------------------------------------------------------------------
+//10AAAAAA 1AAADAAR
+byte z21DCCAccessory(byte *packet, uint16_t Adr, bool state, bool active) {
+	byte len = z21DCCAccAdr(packet, (Adr >> 2) + 1, 0x80 | (active << 3) | ((Adr & 0x03) << 1) | state);
+	return z21DCCEnd(packet, len);
+}
+
+//--------------------------------------------------------------------------------------------
+//10AAAAAA 0AAA0AA1 XXXXXXXX
+byte z21DCCExtAccessory(byte *packet, uint16_t Adr, byte state) {
+	byte len = z21DCCAccAdr(packet, Adr >> 2, ((Adr & 0x03) << 1) | 0x01);	//Adr is the raw DCC output address
+	if (len == 0)
+		return 0;
+	packet[len++] = state;
+	return z21DCCEnd(packet, len);
+}
+
+//*********************************************************************************************
+//Programming on the main:
+
+//--------------------------------------------------------------------------------------------
+byte z21DCCPOMWriteByte(byte *packet, uint16_t Adr, uint16_t cvAdr, uint8_t value) {
+	return z21DCCPOM(packet, z21DCCAdr(packet, Adr), 0x03, cvAdr, value);
+}
+
+//--------------------------------------------------------------------------------------------
+byte z21DCCPOMWriteBit(byte *packet, uint16_t Adr, uint16_t cvAdr, uint8_t value) {
+	return z21DCCPOM(packet, z21DCCAdr(packet, Adr), 0x02, cvAdr, 0xF0 | (value & 0x0F));	//111KDBBB
+}
+
+//--------------------------------------------------------------------------------------------
+byte z21DCCPOMReadByte(byte *packet, uint16_t Adr, uint16_t cvAdr) {
+	return z21DCCPOM(packet, z21DCCAdr(packet, Adr), 0x01, cvAdr, 0);	//verify, answer by RailCom
+}
+
+//--------------------------------------------------------------------------------------------
+byte z21DCCPOMAccWriteByte(byte *packet, uint16_t Adr, uint16_t cvAdr, uint8_t value) {
+	return z21DCCPOM(packet, z21DCCAccAdr(packet, Adr >> 4, 0x80 | (Adr & 0x0F)), 0x03, cvAdr, value);
+}
+
+//--------------------------------------------------------------------------------------------
+byte z21DCCPOMAccWriteBit(byte *packet, uint16_t Adr, uint16_t cvAdr, uint8_t value) {
+	return z21DCCPOM(packet, z21DCCAccAdr(packet, Adr >> 4, 0x80 | (Adr & 0x0F)), 0x02, cvAdr, 0xF0 | (value & 0x0F));
+}
+
+//--------------------------------------------------------------------------------------------
+byte z21DCCPOMAccReadByte(byte *packet, uint16_t Adr, uint16_t cvAdr) {
+	return z21DCCPOM(packet, z21DCCAccAdr(packet, Adr >> 4, 0x80 | (Adr & 0x0F)), 0x01, cvAdr, 0);
+}
+
+//*********************************************************************************************
+//Speed steps:
+
+//--------------------------------------------------------------------------------------------
+byte z21DCCSpeedStep(uint8_t speed, uint8_t steps) {
+	if (steps == 28)
+		return z21DCCRead(Step28, speed & 0x1F);
+	if (steps == 14)
+		speed &= 0x0F;
+	else speed &= 0x7F;
+	if (speed == 0)
+		return 0;
+	if (speed == 1)
+		return z21DCCEStop;
+	return speed - 1;
+}
+
+//--------------------------------------------------------------------------------------------
+byte z21DCCSpeedByte(uint8_t step, uint8_t steps) {
+	if (step == z21DCCEStop)
+		return 0x01;
+	if (step == 0)
+		return 0;
+	if (steps == 28)
+		return step > 28 ? 0x1F : z21DCCRead(Byte28, step);
+	if (steps == 14)
+		return step > 14 ? 0x0F : step + 1;
+	return step > 126 ? 0x7F : step + 1;
+}
@@ -0,0 +1,53 @@
+/*
+  z21dcc.h - DCC packets for the commands of the Z21 LAN protocol
+  Copyright (c) 2026 Philipp Gahtow  All right reserved.
+
+  Notice:
+	- each function write the DCC packet with the error byte into packet[z21DCCPacketMAX]
+	  and return the length, 0 if there is no DCC packet for the values
+	- Adr of a loco: 1 - 127 short address, 128 - 10239 long address
+	- Adr of an accessory like notifyz21Accessory: 0 = decoder 1 output 1 (RCN-213)
+	- Adr of an extended accessory like notifyz21ExtAccessory: raw DCC address, 4 = decoder 1 output 1
+	- Adr of LAN_X_CV_POM_ACCESSORY: decoder << 4 | C | DDD (like the Z21 protocol)
+	- speed like notifyz21LocoSpeed: R + speed, the Z21 use the same bits as DCC;
+	  for 14 steps bit 4 is the light (F0)
+	- cvAdr like notifyz21CVPOM...: 0 = CV1
+*/
+
+#ifndef z21dcc_h
+#define z21dcc_h
+
+// include types & constants of Wiring core API
+#if defined(WIRING)
+ #include <Wiring.h>
+#elif ARDUINO >= 100
+ #include <Arduino.h>
+#else
+ #include <WProgram.h>
+#endif
+
+#define z21DCCPacketMAX 6	//max. Byte of a packet with error byte
+#define z21DCCEStop 0xFF	//z21DCCSpeedStep(): emergency stop
+
+	//Loco:
+byte z21DCCLocoSpeed(byte *packet, uint16_t Adr, uint8_t speed, uint8_t steps);	//steps: 14, 28 or 128
+byte z21DCCLocoFktGroup(byte *packet, uint16_t Adr, uint8_t group, uint8_t fkt);	//group: DB0 of LAN_X_SET_LOCO_FUNCTION_GROUP
+byte z21DCCFktGroup(uint8_t fkt);	//group (DB0) of the function F0 - F68, 0 if unknown
+
+	//Accessory:
+byte z21DCCAccessory(byte *packet, uint16_t Adr, bool state, bool active);	//basic accessory
+byte z21DCCExtAccessory(byte *packet, uint16_t Adr, byte state);	//extended accessory, state = aspect
+
+	//Programming on the main:
+byte z21DCCPOMWriteByte(byte *packet, uint16_t Adr, uint16_t cvAdr, uint8_t value);
+byte z21DCCPOMWriteBit(byte *packet, uint16_t Adr, uint16_t cvAdr, uint8_t value);	//value: 0000VPPP
+byte z21DCCPOMReadByte(byte *packet, uint16_t Adr, uint16_t cvAdr);
+byte z21DCCPOMAccWriteByte(byte *packet, uint16_t Adr, uint16_t cvAdr, uint8_t value);
+byte z21DCCPOMAccWriteBit(byte *packet, uint16_t Adr, uint16_t cvAdr, uint8_t value);	//value: 0000VPPP
+byte z21DCCPOMAccReadByte(byte *packet, uint16_t Adr, uint16_t cvAdr);
+
+	//Speed steps:
+byte z21DCCSpeedStep(uint8_t speed, uint8_t steps);	//speed without R -> 0 = stop, 1 - 126, z21DCCEStop
+byte z21DCCSpeedByte(uint8_t step, uint8_t steps);	//step -> speed without R
+
+#endif
@@ -0,0 +1,332 @@
+/*
+*****************************************************************************
+  *		z21export.cpp - state of the command station in shared memory (Linux)
+  *		Copyright (c) 2026 Philipp Gahtow  All right reserved.
+  *
+  *
+*****************************************************************************
+  * IMPORTANT:
+  *
+  * 	Please contact ROCO Inc. for more details.
+*****************************************************************************
+*/
+
+#if defined(__linux__)
+
+// include this library's description file
+#include <z21.h>
+#include <z21export.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+//futex on the shared memory (not private, other processes):
+static long z21Futex(uint32_t *addr, int op, uint32_t value, const struct timespec *timeout) {
+	return syscall(SYS_futex, addr, op, value, timeout, NULL, 0);
+}
+
+// Constructor /////////////////////////////////////////////////////////////////
+// Function that handles the creation and setup of instances
+
+z21ExportClass::z21ExportClass()
+{
+	State = NULL;
+	Map = NULL;
+	LocoNext = 0;
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+// Functions available in Wiring sketches, this library, and other libraries
+
+//--------------------------------------------------------------------------------------------
+//create the shared memory, copy the state and get all further changes (only from the writer task)
+bool z21ExportClass::begin(z21StateClass &core, const char *name) {
+	if (Map != NULL)
+		end();
+	int fd = shm_open(name, O_CREAT | O_RDWR, 0660);	//reader: same user or group
+	if (fd < 0)
+		return false;
+	if (ftruncate(fd, sizeof(TypeZ21ExportMap)) != 0) {
+		::close(fd);
+		return false;
+	}
+	void *mem = mmap(NULL, sizeof(TypeZ21ExportMap), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mem == MAP_FAILED)
+		return false;
+	Map = (TypeZ21ExportMap*) mem;
+
+	//invalid while the header and the tables change,
+	//"change" and "waiters" stay, a reader of the last run still wait on them:
+	z21AtomicStore(Map->magic, (uint32_t) 0);
+	z21AtomicFence();
+	Map->version = z21ExportVersion;
+	Map->locoMAX = z21StateLocoMAX;
+	Map->trntMAX = z21StateTrntMAX;
+	Map->s88MAX = z21ExportS88MAX;
+	Map->size = sizeof(TypeZ21ExportMap);
+	memset(Map->s88, 0, sizeof(Map->s88));
+	memset(Map->loco, 0, sizeof(Map->loco));
+
+	State = &core;
+	Map->power = State->getPower();
+	LocoNext = 0;
+	for (byte i = 0; i < z21StateLocoMAX; i++) {
+		uint16_t Adr;
+		byte data[6];
+		if (State->getLocoSlot(i, Adr, data)) {
+			Map->loco[i].adr = Adr;
+			memcpy(Map->loco[i].data, data, 6);
+		}
+	}
+	for (uint16_t i = 0; i < z21StateTrntMAX / 8; i++)
+		Map->trnt[i] = State->getTrntByte(i);
+	z21AtomicStore(Map->magic, (uint32_t) z21ExportMagic);
+	changed();
+	return State->attach(this);
+}
+
+//--------------------------------------------------------------------------------------------
+//mark the memory invalid, the reader see the next begin() on the same name
+void z21ExportClass::end() {
+	if (Map == NULL)
+		return;
+	z21AtomicStore(Map->magic, (uint32_t) 0);
+	changed();
+	munmap(Map, sizeof(TypeZ21ExportMap));
+	Map = NULL;
+}
+
+//--------------------------------------------------------------------------------------------
+//changes of the Front-Ends:
+void z21ExportClass::statePower(byte state) {
+	if (Map == NULL)
+		return;
+	z21AtomicStore(Map->power, state);
+	changed();
+}
+
+//--------------------------------------------------------------------------------------------
+void z21ExportClass::stateLoco(uint16_t Adr) {
+	byte data[6];
+	if (Map == NULL || !State->getLoco(Adr, data))
+		return;
+	byte slot = 0;
+	while (slot < z21StateLocoMAX && Map->loco[slot].adr != Adr)
+		slot++;
+	if (slot == z21StateLocoMAX) {
+		slot = LocoNext;
+		LocoNext = (LocoNext + 1) % z21StateLocoMAX;
+	}
+	writeLoco(slot, Adr, data);
+	changed();
+}
+
+//--------------------------------------------------------------------------------------------
+void z21ExportClass::stateTrnt(uint16_t Adr, bool State) {
+	if (Map == NULL || Adr >= z21StateTrntMAX)
+		return;
+	byte value = Map->trnt[Adr >> 3];
+	bitWrite(value, Adr & 0x07, State);
+	z21AtomicStore(Map->trnt[Adr >> 3], value);
+	changed();
+}
+
+//--------------------------------------------------------------------------------------------
+void z21ExportClass::stateExtACC(uint16_t Adr, byte State, byte Status) {
+	//not stored
+}
+
+//--------------------------------------------------------------------------------------------
+//LAN_RMBUS_DATACHANGED: Gruppenindex[0], 10 x Rückmelder
+void z21ExportClass::stateS88(byte *data) {
+	if (Map == NULL || data[0] > 1)
+		return;
+	uint32_t seq = Map->s88seq;
+	z21AtomicStore(Map->s88seq, seq + 1);
+	z21AtomicFence();
+	memcpy(Map->s88 + data[0] * 10, data + 1, 10);
+	z21AtomicStore(Map->s88seq, seq + 2);
+	changed();
+}
+
+// Private Methods ///////////////////////////////////////////////////////////////////////////////////////////////////
+// Functions only available to other functions in this library *******************************************************
+
+//--------------------------------------------------------------------------------------------
+//publish the entry: odd sequence while writing, reader retry
+void z21ExportClass::writeLoco(byte slot, uint16_t Adr, byte *data) {
+	uint32_t seq = Map->loco[slot].seq;
+	z21AtomicStore(Map->loco[slot].seq, seq + 1);
+	z21AtomicFence();
+	Map->loco[slot].adr = Adr;
+	memcpy(Map->loco[slot].data, data, 6);
+	z21AtomicStore(Map->loco[slot].seq, seq + 2);
+}
+
+//--------------------------------------------------------------------------------------------
+//next change, the kernel only if a reader sleep
+void z21ExportClass::changed() {
+	z21AtomicStore(Map->change, Map->change + 1);
+	z21AtomicFence();
+	if (z21AtomicLoad(Map->waiters) > 0)
+		z21Futex(&Map->change, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+//*********************************************************************************************
+//Reader:
+
+z21ExportReader::z21ExportReader()
+{
+	Map = NULL;
+}
+
+//--------------------------------------------------------------------------------------------
+bool z21ExportReader::open(const char *name) {
+	close();
+	int fd = shm_open(name, O_RDWR, 0);		//write only "waiters"
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(TypeZ21ExportMap)) {
+		::close(fd);
+		return false;
+	}
+	void *mem = mmap(NULL, sizeof(TypeZ21ExportMap), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mem == MAP_FAILED)
+		return false;
+	Map = (TypeZ21ExportMap*) mem;
+	if (z21AtomicLoad(Map->magic) != z21ExportMagic || Map->version != z21ExportVersion
+		|| Map->size != sizeof(TypeZ21ExportMap) || Map->locoMAX != z21StateLocoMAX
+		|| Map->trntMAX != z21StateTrntMAX || Map->s88MAX != z21ExportS88MAX) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------
+void z21ExportReader::close() {
+	if (Map != NULL)
+		munmap(Map, sizeof(TypeZ21ExportMap));
+	Map = NULL;
+}
+
+//--------------------------------------------------------------------------------------------
+byte z21ExportReader::getPower() {
+	if (Map == NULL)
+		return csTrackVoltageOff;
+	return z21AtomicLoad(Map->power);
+}
+
+//--------------------------------------------------------------------------------------------
+//consistent copy of the loco state, retry while the writer change the entry
+bool z21ExportReader::getLoco(uint16_t Adr, byte *data) {
+	if (Map == NULL || Adr == 0)
+		return false;
+	for (byte i = 0; i < z21StateLocoMAX; i++) {
+		if (z21AtomicLoad(Map->loco[i].adr) != Adr)
+			continue;	//no fence for the other entries
+		byte copy[6];
+		uint32_t seq;
+		bool found;
+		do {
+			seq = z21AtomicLoad(Map->loco[i].seq);
+			found = (Map->loco[i].adr == Adr);
+			if (found)
+				memcpy(copy, Map->loco[i].data, 6);
+			z21AtomicFence();
+		} while ((seq & 0x01) || (seq != z21AtomicLoad(Map->loco[i].seq)));
+		if (found) {
+			memcpy(data, copy, 6);
+			return true;
+		}
+	}
+	return false;
+}
+
+//--------------------------------------------------------------------------------------------
+//entry of the loco table by index, to list all locos
+bool z21ExportReader::getLocoSlot(byte slot, uint16_t &Adr, byte *data) {
+	if (Map == NULL || slot >= z21StateLocoMAX)
+		return false;
+	uint32_t seq;
+	do {
+		seq = z21AtomicLoad(Map->loco[slot].seq);
+		Adr = Map->loco[slot].adr;
+		memcpy(data, Map->loco[slot].data, 6);
+		z21AtomicFence();
+	} while ((seq & 0x01) || (seq != z21AtomicLoad(Map->loco[slot].seq)));
+	return Adr != 0;
+}
+
+//--------------------------------------------------------------------------------------------
+bool z21ExportReader::getTrnt(uint16_t Adr) {
+	if (Map == NULL || Adr >= z21StateTrntMAX)
+		return false;
+	return bitRead(z21AtomicLoad(Map->trnt[Adr >> 3]), Adr & 0x07);
+}
+
+//--------------------------------------------------------------------------------------------
+void z21ExportReader::getS88(byte *data) {
+	if (Map == NULL) {
+		memset(data, 0, z21ExportS88MAX);
+		return;
+	}
+	uint32_t seq;
+	do {
+		seq = z21AtomicLoad(Map->s88seq);
+		memcpy(data, Map->s88, z21ExportS88MAX);
+		z21AtomicFence();
+	} while ((seq & 0x01) || (seq != z21AtomicLoad(Map->s88seq)));
+}
+
+//--------------------------------------------------------------------------------------------
+uint32_t z21ExportReader::getChange() {
+	if (Map == NULL)
+		return 0;
+	return z21AtomicLoad(Map->change);
+}
+
+//--------------------------------------------------------------------------------------------
+//sleep inside the kernel until the writer count the next change
+bool z21ExportReader::wait(uint32_t change, unsigned long timeout) {
+	if (Map == NULL)
+		return false;
+	if (getChange() != change)
+		return true;
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	end.tv_sec += timeout / 1000;
+	end.tv_nsec += (timeout % 1000) * 1000000L;
+	if (end.tv_nsec >= 1000000000L) {
+		end.tv_sec++;
+		end.tv_nsec -= 1000000000L;
+	}
+	z21AtomicFetchAdd(Map->waiters, 1);
+	z21AtomicFence();	//the writer see "waiters" or we see the change
+	while (getChange() == change) {
+		struct timespec now, rest;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		rest.tv_sec = end.tv_sec - now.tv_sec;
+		rest.tv_nsec = end.tv_nsec - now.tv_nsec;
+		if (rest.tv_nsec < 0) {
+			rest.tv_sec--;
+			rest.tv_nsec += 1000000000L;
+		}
+		if (rest.tv_sec < 0)
+			break;		//timeout
+		z21Futex(&Map->change, FUTEX_WAIT, change, &rest);	//EAGAIN, EINTR: check again
+	}
+	z21AtomicFetchAdd(Map->waiters, -1);
+	return getChange() != change;
+}
+
+#endif
@@ -0,0 +1,114 @@
+/*
+  z21export.h - state of the command station in shared memory for local programs (Linux)
+  Copyright (c) 2026 Philipp Gahtow  All right reserved.
+
+  Notice:
+	- only on Linux, needs Z21STATE: z21ExportClass is a Front-End (z21StateListener) of the state,
+	  it copy each change into a POSIX shared memory (shm_open) with the name z21ExportName
+	- local programs (automatic, track diagram, logging) read power, locos, turnouts and S88
+	  with z21ExportReader direct from the memory, no Z21 LAN client and no broadcast for them
+	- same lock free rules like z21state.h: one writer (the task that call receive()),
+	  each loco entry and the S88 data have a sequence counter (odd = writing), the reader retry
+	- each change increment "change" inside the header, a reader sleep on this word (futex)
+	  until the next change, the writer only call the kernel if a reader is waiting
+	- the header has a magic, the version and the size of the tables, a reader refuse other versions
+	- include after z21.h, build with z21state.cpp z21export.cpp (old glibc: -lrt)
+*/
+
+#ifndef z21export_h
+#define z21export_h
+
+// include types & constants of Wiring core API
+#if defined(WIRING)
+ #include <Wiring.h>
+#elif ARDUINO >= 100
+ #include <Arduino.h>
+#else
+ #include <WProgram.h>
+#endif
+
+#if defined(__linux__)
+
+#define z21ExportName "/z21state"		//name of the shared memory
+#define z21ExportMagic 0x4531325AUL		//"Z21E"
+#define z21ExportVersion 0x01			//change with each new layout
+#define z21ExportS88MAX 20				//LAN_RMBUS_DATACHANGED: 2 groups with 10 modules
+
+struct TypeZ21ExportLoco {
+  uint32_t seq;		//sequence counter, odd while writing
+  uint16_t adr;		//0 = unused
+  uint8_t data[6];	//like notifyz21LocoState: Steps[0], Speed[1], F0[2], F1[3], F2[4], F3[5]
+};
+
+//layout of the shared memory:
+struct TypeZ21ExportMap {
+  uint32_t magic;		//z21ExportMagic, written last
+  uint16_t version;		//z21ExportVersion
+  uint16_t locoMAX;		//entries of loco[]
+  uint16_t trntMAX;		//turnouts in trnt[]
+  uint16_t s88MAX;		//bytes of s88[]
+  uint32_t size;		//sizeof(TypeZ21ExportMap)
+  uint32_t change;		//counter of the changes (futex)
+  uint32_t waiters;		//reader inside wait()
+  uint32_t s88seq;		//sequence counter of s88[]
+  uint8_t power;		//like getPower()
+  uint8_t reserved[3];
+  uint8_t s88[z21ExportS88MAX];	//module 1 - 20, one bit for each input
+  TypeZ21ExportLoco loco[z21StateLocoMAX];
+  uint8_t trnt[z21StateTrntMAX / 8];	//one bit for each turnout
+};
+
+//--------------------------------------------------------------------------------------------
+//Writer: Front-End of the state
+class z21ExportClass : public z21StateListener
+{
+  // user-accessible "public" interface
+  public:
+	z21ExportClass(void);	//Constuctor
+
+	bool begin(z21StateClass &core, const char *name = z21ExportName);	//create the memory, copy the state, attach
+	void end();		//remove the memory
+
+	void statePower(byte state);
+	void stateLoco(uint16_t Adr);
+	void stateTrnt(uint16_t Adr, bool State);
+	void stateExtACC(uint16_t Adr, byte State, byte Status);
+	void stateS88(byte *data);
+
+  // library-accessible "private" interface
+  private:
+	z21StateClass *State;
+	TypeZ21ExportMap *Map;
+	byte LocoNext;		//next entry to replace
+
+	void writeLoco(byte slot, uint16_t Adr, byte *data);	//publish the entry
+	void changed();		//wake the reader
+};
+
+//--------------------------------------------------------------------------------------------
+//Reader: any local process
+class z21ExportReader
+{
+  // user-accessible "public" interface
+  public:
+	z21ExportReader(void);	//Constuctor
+
+	bool open(const char *name = z21ExportName);	//false if no writer or other version
+	void close();
+
+	byte getPower();
+	bool getLoco(uint16_t Adr, byte *data);	//false if the loco is unknown
+	bool getLocoSlot(byte slot, uint16_t &Adr, byte *data);	//entry of the table, false if unused
+	bool getTrnt(uint16_t Adr);		//position of the turnout, false if unknown
+	void getS88(byte *data);		//z21ExportS88MAX byte
+	uint32_t getChange();		//counter of the changes
+	bool wait(uint32_t change, unsigned long timeout);	//sleep until getChange() != change, false after timeout ms
+
+  // library-accessible "private" interface
+  private:
+	TypeZ21ExportMap *Map;
+};
+
+#endif
+
+#endif
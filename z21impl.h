@@ -0,0 +1,2671 @@
+/*
+  z21impl.h - implementation of the library for Z21 mobile protocoll
+  Copyright (c) 2013-2022 Philipp Gahtow  All right reserved.
+
+  Notice:
+	- z21.cpp build z21Class (z21Base<z21WeakHandler>) with the weak notify functions
+	- for an own Handler include this file inside one .cpp/.ino of the sketch:
+		#include <z21.h>
+		#include <z21impl.h>
+		struct myHandler : z21NoHandler {
+			static void EthSend(uint8_t client, uint8_t *data) { ... }
+			static void LocoSpeed(uint16_t Adr, uint8_t speed, uint8_t steps) { ... }
+		};
+		z21Base<myHandler> z21;
+	- hooks that are not in the Handler compile away
+*/
+
+#ifndef z21impl_h
+#define z21impl_h
+
+#include <z21header.h>
+
+#if defined(__arm__)
+#include <DueFlashStorage.h>
+extern DueFlashStorage FlashStore;
+#define FSTORAGE 	FlashStore
+#define FSTORAGEMODE write
+
+#elif defined(ESP32)  //use NVS on ESP32!
+#include "z21nvs.h"
+extern z21nvsClass NVSZ21;
+#define FSTORAGE NVSZ21
+#define FSTORAGEMODE write
+
+#else
+// AVR based Boards follows
+#include <EEPROM.h>
+#define FSTORAGE 	EEPROM
+	#if defined(ESP8266) || defined(ESP32) //ESP8266 or ESP32
+		#define FSTORAGEMODE write
+	#else
+		#define FSTORAGEMODE update
+	#endif
+#endif
+
+#if !defined(Z21NOLOCONET)
+//--------------------------------------------------------------------------------------------
+//LocoNet opcode class for routing of the LocoNet tunnel:
+#define LNclassGeneral	0x00	//Z21bcLocoNet
+#define LNclassLoco		0x01	//Z21bcLocoNetLocos
+#define LNclassSwitch	0x02	//Z21bcLocoNetSwitches
+#define LNclassSensor	0x03	//Z21bcLocoNetGBM
+
+constexpr byte LNopcClass(byte opc) {
+	return	(opc == 0xA0 || opc == 0xA1 || opc == 0xA2 || opc == 0xA3 ||	//LOCO_SPD, LOCO_DIRF, LOCO_SND, LOCO_F9F12
+			 opc == 0xB5 || opc == 0xB6 || opc == 0xB8 || opc == 0xB9 ||	//SLOT_STAT1, CONSIST_FUNC, UNLINK_SLOTS, LINK_SLOTS
+			 opc == 0xBA || opc == 0xBB || opc == 0xBE || opc == 0xBF ||	//MOVE_SLOTS, RQ_SL_DATA, LOCO_ADR_P2, LOCO_ADR
+			 opc == 0xD4 || opc == 0xE6 || opc == 0xE7 || opc == 0xEE ||	//UHLI_FUN, SL_RD_DATA_P2, SL_RD_DATA, WR_SL_DATA_P2
+			 opc == 0xEF) ? LNclassLoco :									//WR_SL_DATA
+			(opc == 0xB0 || opc == 0xB1 || opc == 0xBC || opc == 0xBD) ? LNclassSwitch :	//SW_REQ, SW_REP, SW_STATE, SW_ACK
+			(opc == 0xB2 || opc == 0xD0 || opc == 0xE4) ? LNclassSensor :	//INPUT_REP, MULTI_SENSE, LISSY_REP
+			LNclassGeneral;
+}
+
+//4 opcodes per byte with 2 bit class each:
+#define LNopcPack(opc) (LNopcClass(opc) | (LNopcClass(opc + 1) << 2) | (LNopcClass(opc + 2) << 4) | (LNopcClass(opc + 3) << 6))
+
+static constexpr byte LNopcTable[32] = {
+	LNopcPack(0x80), LNopcPack(0x84), LNopcPack(0x88), LNopcPack(0x8C),
+	LNopcPack(0x90), LNopcPack(0x94), LNopcPack(0x98), LNopcPack(0x9C),
+	LNopcPack(0xA0), LNopcPack(0xA4), LNopcPack(0xA8), LNopcPack(0xAC),
+	LNopcPack(0xB0), LNopcPack(0xB4), LNopcPack(0xB8), LNopcPack(0xBC),
+	LNopcPack(0xC0), LNopcPack(0xC4), LNopcPack(0xC8), LNopcPack(0xCC),
+	LNopcPack(0xD0), LNopcPack(0xD4), LNopcPack(0xD8), LNopcPack(0xDC),
+	LNopcPack(0xE0), LNopcPack(0xE4), LNopcPack(0xE8), LNopcPack(0xEC),
+	LNopcPack(0xF0), LNopcPack(0xF4), LNopcPack(0xF8), LNopcPack(0xFC)
+};
+
+//BC-Flag for each class:
+static const unsigned long LNclassBcFlag[4] = { Z21bcLocoNet, Z21bcLocoNetLocos, Z21bcLocoNetSwitches, Z21bcLocoNet | Z21bcLocoNetGBM };
+
+static inline byte getLNClass(byte opc) {
+	return (LNopcTable[(opc >> 2) & 0x1F] >> ((opc & 0x03) << 1)) & 0x03;
+}
+#endif
+
+#if defined(Z21STATS)
+//--------------------------------------------------------------------------------------------
+//Histogram bucket for the time in µs (log2):
+static inline byte z21StatBucket(unsigned long us) {
+	byte b = 0;
+	while (us > 0 && b < z21StatHistMAX - 1) {
+		us >>= 1;
+		b++;
+	}
+	return b;
+}
+
+//measure the time until the end of the function:
+class z21StatTimer {
+  public:
+	z21StatTimer(uint32_t *hist) : hist(hist), start(micros()) {}
+	~z21StatTimer() { hist[z21StatBucket(micros() - start)]++; }
+	unsigned long time() { return micros() - start; }
+  private:
+	uint32_t *hist;
+	unsigned long start;
+};
+#endif
+
+// Constructor /////////////////////////////////////////////////////////////////
+// Function that handles the creation and setup of instances
+
+template <class Handler>
+z21Base<Handler>::z21Base()
+{
+	// initialize this instance's variables 
+    z21IPpreviousMillis = 0;
+    Railpower = csTrackVoltageOff;
+	TXBufferLen = 0;
+	TXBufferClient = 0;
+	memset(ActIP, 0, sizeof(ActIP));
+	memset(EndpointHash, 0, sizeof(EndpointHash));
+	clearIPSlots();
+	clearExtACC();
+	for (byte i = 0; i < z21CVReqMAX; i++)
+		CVReq[i].type = 0;
+	#if defined(Z21STATS)
+	clearStats();
+	#endif
+	#if defined(Z21EVENTQUEUE)
+	EventHead = 0;
+	EventTail = 0;
+	EventPower = 0;
+	EventPowerSeq = 0;
+	EventPowerDone = 0;
+	CVResultHead = 0;
+	CVResultTail = 0;
+	#endif
+	#if defined(Z21SENDQUEUE)
+	for (byte i = 0; i < z21clientMAX; i++)
+		SendQueue[i].count = 0;
+	#endif
+	#if defined(Z21PERSIST)
+	for (uint16_t i = 0; i < z21PersistBlocks; i++)
+		PersistCRC[i] = 0;		//store all blocks once
+	PersistNext = 0;
+	PersistTime = 0;
+	#endif
+	#if defined(Z21ACCQUEUE)
+	AccCount = 0;
+	AccActiveCount = 0;
+	AccActiveLimit = z21AccActive;
+	AccPulse = z21AccPulse;
+	AccStart = 0;
+	AccSettle = 0;
+	AccRoute = false;
+	#endif
+	#if defined(Z21SYSINFO)
+	memset(&SysInfo, 0, sizeof(SysInfo));
+	SysInfo.minTime = z21SysInfoMin;
+	SysInfo.maxTime = z21SysInfoMax;
+	SysInfo.bandCurrent = z21SysInfoBandCurrent;
+	SysInfo.bandVoltage = z21SysInfoBandVoltage;
+	#endif
+	#if defined(Z21STATE)
+	State = &OwnState;
+	#endif
+	#if defined(Z21TRACE)
+	TraceHead = 0;
+	TraceTail = 0;
+	TraceLost = 0;
+	for (byte i = 0; i < z21TraceMAX; i++)
+		Trace[i].seq = 0;
+	#endif
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+// Functions available in Wiring sketches, this library, and other libraries
+
+//*********************************************************************************************
+//Daten ermitteln und Auswerten
+template <class Handler>
+void z21Base<Handler>::receive(uint8_t client, uint8_t *packet) 
+{
+	Handler::Capture(z21TraceRX, client, packet);
+	#if defined(Z21TRACE)
+	traceAdd(client, z21TraceRX, packet);
+	#endif
+	addIPToSlot(client, 0);
+	// send a reply, to the IP address and port that sent us the packet we received
+	int header = (packet[3]<<8) + packet[2];
+	byte data[16]; 			//z21 send storage
+	
+	#if defined(Z21STATS)
+	z21StatTimer timer(Stats.receiveTime);
+	byte slot = 0;
+	while (slot < z21clientMAX && ActIP[slot].client != client)
+		slot++;
+	if (header < 256)
+		Stats.rxHeader[header]++;
+	if (header == LAN_X_Header)
+		Stats.rxXHeader[packet[4]]++;
+	#endif
+	
+	switch (header) {
+		case LAN_GET_SERIAL_NUMBER:
+		  data[0] = FSTORAGE.read(CONFz21SnLSB);
+		  data[1] = FSTORAGE.read(CONFz21SnMSB);
+		  data[2] = 0x00; 
+		  data[3] = 0x00;
+		  EthSend(client, 0x08, LAN_GET_SERIAL_NUMBER, data, false, Z21bcNone); //Seriennummer 32 Bit (little endian)
+		  break; 
+		case LAN_GET_HWINFO:
+		  data[0] = z21HWTypeLSB;  //HwType 32 Bit
+		  data[1] = z21HWTypeMSB;
+		  data[2] = 0x00; 
+		  data[3] = 0x00;
+		  data[4] = z21FWVersionLSB;  //FW Version 32 Bit
+		  data[5] = z21FWVersionMSB;
+		  data[6] = 0x00; 
+		  data[7] = 0x00;
+		  EthSend (client, 0x0C, LAN_GET_HWINFO, data, false, Z21bcNone);
+		  break;  
+		case LAN_LOGOFF:
+		  clearIPSlot(client);
+		  //Antwort von Z21: keine
+		  break; 
+		case LAN_GET_CODE:	//SW Feature-Umfang der Z21   
+		  /*#define Z21_NO_LOCK        0x00  // keine Features gesperrt 
+			#define z21_START_LOCKED   0x01  // z21 start: Fahren und Schalten per LAN gesperrt 
+			#define z21_START_UNLOCKED 0x02  // z21 start: alle Feature-Sperren aufgehoben */
+		  data[0] = 0x00; //keine Features gesperrt
+		  EthSend (client, 0x05, LAN_GET_CODE, data, false, Z21bcNone);	
+		  break;
+		case (LAN_X_Header):
+		  //---------------------- LAN X-Header BEGIN ---------------------------	
+		  switch (packet[4]) { //X-Header
+		  case LAN_X_GET_SETTING: 
+			//---------------------- Switch BD0 BEGIN ---------------------------	
+			switch (packet[5]) {  //DB0
+			case 0x21:
+			  data[0] = LAN_X_GET_VERSION;	//X-Header: 0x63
+			  data[1] = 0x21;	//DB0
+			  data[2] = 0x30;   //X-Bus Version
+			  data[3] = 0x12;  //ID der Zentrale
+			  EthSend (client, 0x09, LAN_X_Header, data, true, Z21bcNone);
+			  break;
+			case 0x24:
+			  data[0] = LAN_X_STATUS_CHANGED;	//X-Header: 0x62
+			  data[1] = 0x22;			//DB0
+			  data[2] = Railpower;		//DB1: Status
+			  //ZDebug.print("X_GET_STATUS "); 
+				  //csEmergencyStop  0x01 // Der Nothalt ist eingeschaltet 
+				  //csTrackVoltageOff  0x02 // Die Gleisspannung ist abgeschaltet 
+				  //csShortCircuit  0x04 // Kurzschluss 
+				  //csProgrammingModeActive 0x20 // Der Programmiermodus ist aktiv 
+			  EthSend (client, 0x08, LAN_X_Header, data, true, Z21bcNone);
+			  break;
+			case 0x80:
+			  addEvent(z21EventRailPower, 0, csTrackVoltageOff);
+			  break;
+			case 0x81:
+			  
+			  data[0] = LAN_X_BC_TRACK_POWER;
+			  data[1] = 0x01;
+			  EthSend(client, 0x07, LAN_X_Header, data, true, Z21bcNone);
+			  
+			  addEvent(z21EventRailPower, 0, csNormal);
+				
+			  break;  
+			}
+			//---------------------- Switch DB0 ENDE ---------------------------	
+			break;  //ENDE DB0
+		  #if !defined(Z21NOWLANMAUS)
+		  case LAN_X_DCC_READ_REGISTER: 
+			if (packet[5] == 0x15) {  //DB0	- SPECIAL: WLANMaus CV Read!
+				addCVReq(client, z21CVReqRead, 0, packet[6]-1, 0); //CV_MSB, CV_LSB
+			}
+			break;
+		  #endif
+		  case LAN_X_CV_READ:
+			if (packet[5] == 0x11) {  //DB0
+			  addCVReq(client, z21CVReqRead, 0, word(packet[6], packet[7]), 0); //CV_MSB, CV_LSB
+			}
+			#if !defined(Z21NOWLANMAUS)
+			if (packet[5] == 0x16) {  //DB0	- SPECIAL: WLANMaus CV Write!
+				addCVReq(client, z21CVReqWrite, 0, packet[6]-1, packet[7]); //CV_MSB, CV_LSB, value
+			}
+			#endif
+			break;             
+		  case LAN_X_CV_WRITE: 
+			if (packet[5] == 0x12) {  //DB0
+			  addCVReq(client, z21CVReqWrite, 0, word(packet[6], packet[7]), packet[8]); //CV_MSB, CV_LSB, value
+			}
+			break;
+		  case LAN_X_CV_POM: {	//X-Header = 0xE6
+			uint16_t CVAdr = ((packet[8] & 0b11) << 8) + packet[9];
+			byte value = packet[10];
+			if (packet[5] == 0x30) {  //DB0 = LAN_X_CV_POM
+			  uint16_t Adr = ((packet[6] & 0x3F) << 8) + packet[7];
+			  if ((packet[8] & 0xFC) == LAN_X_CV_POM_WRITE_BYTE) {		//DB3 Option 0xEC
+				addEvent(z21EventPOMWriteByte, Adr, value, 0, CVAdr);  //set Byte
+			  }
+			  else if ((packet[8] & 0xFC) == LAN_X_CV_POM_WRITE_BIT) {	//DB3 Option 0xE8
+				addEvent(z21EventPOMWriteBit, Adr, value, 0, CVAdr);  //set Bit
+			  }
+			  else if ((packet[8] & 0xFC) == LAN_X_CV_POM_READ_BYTE) {	//DB3 Option 0xE4
+				  addCVReq(client, z21CVReqPOMRead, Adr, CVAdr, 0);  //read byte
+			  }
+			}
+			#if !defined(Z21NOPOMACC)
+			else if (packet[5] == 0x31) {  //DB0 = LAN_X_CV_POM_ACCESSORY
+			  uint16_t Adr = ((packet[6] & 0x1F) << 8) + packet[7];	
+			  if ((packet[8] & 0xFC) == LAN_X_CV_POM_ACCESSORY_WRITE_BYTE) {		//DB3 Option 0xEC
+				addEvent(z21EventPOMACCWriteByte, Adr, value, 0, CVAdr);  //set Byte
+			  }
+			  else if ((packet[8] & 0xFC) == LAN_X_CV_POM_ACCESSORY_WRITE_BIT) {	//DB3 Option 0xE8
+				addEvent(z21EventPOMACCWriteBit, Adr, value, 0, CVAdr);  //set Bit
+			  }
+			  else if ((packet[8] & 0xFC) == LAN_X_CV_POM_ACCESSORY_READ_BYTE) {	//DB3 Option 0xE4
+				addCVReq(client, z21CVReqPOMACCRead, Adr, CVAdr, 0);  //read byte
+			  }
+			}
+			#endif
+			break;      
+		  }
+		  case LAN_X_SET_TURNOUT: {  //and notify other Clients with LAN_X_GET_TURNOUT_INFO!
+			//bool TurnOnOff = bitRead(packet[7],3);  //Spule EIN/AUS
+			#if defined(Z21ACCQUEUE)
+			if (bitRead(packet[7], 3))	//the library switch the coil off
+				accQueue((packet[5] << 8) + packet[6], bitRead(packet[7], 0));
+			#else
+			addEvent(z21EventAccessory, (packet[5] << 8) + packet[6], bitRead(packet[7], 0), bitRead(packet[7], 3));
+									//	Addresse					Links/Rechts			Spule EIN/AUS
+			#endif
+			#if defined(Z21STATE)
+			if (bitRead(packet[7], 3)) {	//new position with the coil on
+				State->setTrnt((packet[5] << 8) + packet[6], bitRead(packet[7], 0));
+				State->changedTrnt(this, (packet[5] << 8) + packet[6], bitRead(packet[7], 0));	//Clients der anderen Front-Ends
+			}
+			#endif
+			//Check if Broadcast Flag is correct set up?
+			bool BCset = true;
+			for (byte i = 0; i < z21clientMAX; i++) {
+			  if (ActIP[i].client == client) {
+			        if (ActIP[i].BCFlag == 0) {
+				  BCset = false;
+				}
+				break;
+			  }
+			}
+			//Fall to next if no BCFlag is set!
+			if (BCset)
+				break;
+		  }
+		  case LAN_X_GET_TURNOUT_INFO: {
+			  if (Handler::hasAccessoryInfo()) {
+				  data[0] = 0x43;  //X-HEADER
+				  data[1] = packet[5]; //High
+				  data[2] = packet[6]; //Low
+				  if (Handler::AccessoryInfo((packet[5] << 8) + packet[6]) == true)
+					  data[3] = 0x02;  //active
+				  else data[3] = 0x01;  //inactive
+			      EthSend (client, 0x09, LAN_X_Header, data, true, Z21bcNone);    //BC new 23.04. !!!(old = 0)
+			  }
+			  #if defined(Z21STATE)
+			  else {	//last known position
+				  data[0] = 0x43;  //X-HEADER
+				  data[1] = packet[5]; //High
+				  data[2] = packet[6]; //Low
+				  data[3] = State->getTrnt((packet[5] << 8) + packet[6]) + 1;
+			      EthSend (client, 0x09, LAN_X_Header, data, true, Z21bcNone);
+			  }
+			  #endif
+			  break;
+		  }
+		  case LAN_X_SET_EXT_ACCESSORY: {
+			//Schalten Erweiterten Zubehördecoder
+			addEvent(z21EventExtAccessory, (packet[5] << 8) + packet[6], packet[7]);
+			if (storeExtACC((packet[5] << 8) + packet[6], packet[7])) {	//speichere letztes Kommando!
+				returnExtACCInfo(0, (packet[5] << 8) + packet[6], packet[7], 0x00);	//Änderung an alle
+				#if defined(Z21STATE)
+				State->changedExtACC(this, (packet[5] << 8) + packet[6], packet[7], 0x00);
+				#endif
+			}
+			else returnExtACCInfo(client, (packet[5] << 8) + packet[6], packet[7], 0x00);	//unverändert, nur an den anfragenden Client
+			break;
+		  }
+		  case LAN_X_GET_EXT_ACCESSORY_INFO: {
+			//kann mit folgendem Kommando der letzte an einen Erweiterten Zubehördecoder übertragene Befehl abgefragt werden.
+			byte slot = findExtACC((packet[5] << 8) + packet[6]);
+			if (slot < z21ExtAccMAX)
+				returnExtACCInfo(client, ExtACC[slot].adr, ExtACC[slot].state, 0x00);	//0x00  Data Valid;
+			else returnExtACCInfo(client, (packet[5] << 8) + packet[6], 0x00, 0xFF);	//0xFF  Data Unknown
+			break;  
+		  }
+		  case LAN_X_SET_STOP:
+			addEvent(z21EventRailPower, 0, csEmergencyStop);
+			break;  
+		  case LAN_X_GET_LOCO_INFO:
+			if (packet[5] == 0xF0) {  //DB0
+			  //ZDebug.print("X_GET_LOCO_INFO: ");
+			  //Antwort: LAN_X_LOCO_INFO  Adr_MSB - Adr_LSB
+			  #if defined(Z21EVENTQUEUE)
+			  returnLocoStateFull(client, word(packet[6] & 0x3F, packet[7]), false, true);	//Z21STATE is newer than the DCC task
+			  #else
+			  returnLocoStateFull(client, word(packet[6] & 0x3F, packet[7]), false);	
+			  #endif
+			}
+			break;  
+		  case LAN_X_SET_LOCO:
+			//setLocoBusy:
+			addBusySlot(client,word(packet[6] & 0x3F, packet[7]));
+			
+			if ((packet[5] & 0xF0) == 0x10) {  //DB0 => 0x1x = LAN_X_SET_LOCO_DRIVE
+				  //ZDebug.print("X_SET_LOCO_DRIVE ");
+				  byte steps = 128;	//default value S=3; DCC 128 Fahrstufen
+				  if (packet[5] == 0x12)	//S=2; DCC 28 Fahrstufen
+					steps = 28;
+				  else if (packet[5] == 0x10)	//S=0; DCC 14 Fahrstufen
+					steps = 14;
+				addEvent(z21EventLocoSpeed, word(packet[6] & 0x3F, packet[7]), packet[8], steps);
+				#if defined(Z21STATE)
+				State->setLocoSpeed(word(packet[6] & 0x3F, packet[7]), packet[8], steps);
+				#endif
+			}
+			else if (packet[5] == LAN_X_SET_LOCO_FUNCTION) {  //DB0 = 0xF8
+			  //LAN_X_SET_LOCO_FUNCTION  Adr_MSB        Adr_LSB            Type (00=AUS/01=EIN/10=UM)      Funktion
+			  addEvent(z21EventLocoFkt, word(packet[6] & 0x3F, packet[7]), packet[8] >> 6, packet[8] & 0b00111111);
+			  #if defined(Z21STATE)
+			  State->setLocoFkt(word(packet[6] & 0x3F, packet[7]), packet[8] >> 6, packet[8] & 0b00111111);
+			  #endif
+			  //uint16_t Adr, uint8_t type, uint8_t fkt
+			}
+			//LAN_X_SET_LOCO_FUNCTION_GROUP:
+			else if ((packet[5] >= 0x20 && packet[5] <= 0x23) || packet[5] == 0x28 || packet[5] == 0x29) {	//F0 - F36
+				addEvent(z21EventLocoFktGroup, word(packet[6] & 0x3F, packet[7]), packet[5], packet[8]);
+				#if defined(Z21STATE)
+				State->setLocoFktGroup(word(packet[6] & 0x3F, packet[7]), packet[5], packet[8]);
+				#endif
+			}
+			else if (packet[5] == 0x2A || packet[5] == 0x2B || packet[5] == 0x50 || packet[5] == 0x51) {	// F37 - F68
+				addEvent(z21EventLocoFktGroup, word(packet[6] & 0x3F, packet[7]), packet[5], packet[8]);
+				return;	//keine Rückmeldung an die LAN-Clients
+			}
+			#if defined(Z21EVENTQUEUE)
+			returnLocoStateFull(client, word(packet[6] & 0x3F, packet[7]), true, true, packet[5], packet[8]);	//DCC task has not the command yet
+			#else
+			returnLocoStateFull(client, word(packet[6] & 0x3F, packet[7]), true);	//Rückmeldung an die LAN-Clients!
+			#endif
+			#if defined(Z21STATE)
+			State->changedLoco(this, word(packet[6] & 0x3F, packet[7]));	//Clients der anderen Front-Ends
+			#endif
+			break;  
+		  case LAN_X_SET_LOCO_BINARY_STATE:
+			if (packet[5] == 0x5F) {	//DB0 = Binary State
+				addEvent(z21EventLocoFktExt, word(packet[6] & 0x3F, packet[7]), packet[8], packet[9]);
+			}
+			break;
+		  case LAN_X_GET_FIRMWARE_VERSION:
+			data[0] = 0xF3;		//identify Firmware (not change)
+			data[1] = 0x0A;		//identify Firmware (not change)
+			data[2] = z21FWVersionMSB;   //V_MSB
+			data[3] = z21FWVersionLSB;  //V_LSB
+			EthSend (client, 0x09, LAN_X_Header, data, true, Z21bcNone);
+			break;     
+		  #if !defined(Z21NOWLANMAUS)
+		  case 0x73:
+			//LAN_X_??? WLANmaus periodische Abfrage: 
+			//0x09 0x00 0x40 0x00 0x73 0x00 0xFF 0xFF 0x00
+			//length X-Header	XNet-Msg			  speed?
+			//set Broadcastflags for WLANmaus:
+			if (addIPToSlot(client, 0x00) == 0)
+				addIPToSlot(client, Z21bcAll);
+			break;
+		  #endif
+		  default:
+			#if defined(Z21STATS)
+			Stats.rxUnknown++;
+			#endif
+			data[0] = 0x61;
+			data[1] = 0x82;
+			EthSend (client, 0x07, LAN_X_Header, data, true, Z21bcNone);
+		  }
+		  //---------------------- LAN X-Header ENDE ---------------------------	
+		  break; 
+		case (LAN_SET_BROADCASTFLAGS): {
+			unsigned long bcflag = packet[7];
+			bcflag = packet[6] | (bcflag << 8);
+			bcflag = packet[5] | (bcflag << 8);
+			bcflag = packet[4] | (bcflag << 8);
+			addIPToSlot(client, bcflag & z21BcMask);	//only the compiled parts
+			//no inside of the protokoll, but good to have:
+			addEvent(z21EventRailPower, 0, Railpower); //Zustand Gleisspannung Antworten
+			break;
+		  }
+		case (LAN_GET_BROADCASTFLAGS): {
+			unsigned long flag = addIPToSlot(client, 0x00);  
+			data[0] = flag;
+			data[1] = flag >> 8;
+			data[2] = flag >> 16;
+			data[3] = flag >> 24;
+			EthSend (client, 0x08, LAN_GET_BROADCASTFLAGS, data, false, Z21bcNone); 
+			break;
+		  }
+		case (LAN_GET_LOCOMODE):
+			/*
+			In der Z21 kann das Ausgabeformat (DCC, MM) pro Lok-Adresse persistent gespeichert werden. 
+			Es können maximal 256 verschiedene Lok-Adressen abgelegt werden. Jede Adresse >= 256 ist automatisch DCC.
+			*/
+			data[0] = packet[4];
+			data[1] = packet[5];
+			data[2] = 0;	//0=DCC Format; 1=MM Format
+			EthSend (client, 0x07, LAN_GET_LOCOMODE, data, false, Z21bcNone);
+		break;
+		case (LAN_SET_LOCOMODE):
+			//nothing to replay all DCC Format
+		break;
+		case (LAN_GET_TURNOUTMODE):
+			/*
+			In der Z21 kann das Ausgabeformat (DCC, MM) pro Funktionsdecoder-Adresse persistent gespeichert werden. 
+			Es können maximal 256 verschiedene Funktionsdecoder -Adressen gespeichert werden. Jede Adresse >= 256 ist automatisch DCC.
+			*/
+			data[0] = packet[4];
+			data[1] = packet[5];
+			data[2] = 0;	//0=DCC Format; 1=MM Format
+			EthSend (client, 0x07, LAN_GET_LOCOMODE, data, false, Z21bcNone);
+		break;
+		case (LAN_SET_TURNOUTMODE):
+			//nothing to replay all DCC Format
+		break;
+		case (LAN_RMBUS_GETDATA):
+			  //ask for group state 'Gruppenindex'
+			  Handler::S88Data(packet[4]);	//normal Antwort hier nur an den anfragenden Client! (Antwort geht hier an alle!)
+			  break;
+		case (LAN_RMBUS_PROGRAMMODULE):
+		break;
+		case (LAN_SYSTEMSTATE_GETDATA): {	//System state
+			#if defined(Z21SYSINFO)
+			if (SysInfo.valid) {	//last sample, not the hook
+				returnSystemInfo(client, SysInfo.current, SysInfo.filtered >> z21SysInfoFilter, SysInfo.voltage, SysInfo.temp, SysInfo.stateEx);
+				break;
+			}
+			#endif
+			  Handler::getSystemInfo(client);
+			break;
+		}
+		#if !defined(Z21NORAILCOM)
+		case (LAN_RAILCOM_GETDATA): {
+			  uint16_t Adr = 0;
+			  if (packet[4] == 0x01) {	//RailCom-Daten für die gegebene Lokadresse anfordern
+				Adr = word(packet[6],packet[5]);
+			  }
+			  if (Handler::hasRailcom())
+				  Adr = Handler::Railcom();	//return global Railcom Adr
+			  data[0] = Adr >> 8;	//LocoAddress
+			  data[1] = Adr & 0xFF;	//LocoAddress
+			  data[2] = 0x00;	//UINT32 ReceiveCounter Empfangszähler in Z21 
+			  data[3] = 0x00;
+			  data[4] = 0x00;
+			  data[5] = 0x00;
+			  data[6] = 0x00;	//UINT32 ErrorCounter Empfangsfehlerzähler in Z21
+			  data[7] = 0x00;
+			  data[8] = 0x00;
+			  data[9] = 0x00;
+			  /*
+			  data[10] = 0x00;	//UINT8 Reserved1 experimentell, siehe Anmerkung 
+			  data[11] = 0x00;	//UINT8 Reserved2 experimentell, siehe Anmerkung 
+			  data[12] = 0x00;	//UINT8 Reserved3 experimentell, siehe Anmerkung 
+			  */
+			  EthSend (client, 0x0E, LAN_RAILCOM_DATACHANGED, data, false, Z21bcNone);
+			break;  
+		}
+		#endif
+		#if !defined(Z21NOLOCONET)
+		case (LAN_LOCONET_FROM_LAN): {
+			
+			byte LNdata[packet[0] - 0x04];  //n Bytes
+			for (byte i = 0; i < (packet[0] - 0x04); i++) 
+				LNdata[i] = packet[0x04+i];
+			Handler::LNSendPacket(LNdata, packet[0] - 0x04);  
+			//Melden an andere LAN-Client das Meldung auf LocoNet-Bus geschrieben wurde
+			EthSendLN(client, packet[0], LAN_LOCONET_FROM_LAN, LNdata);  //LAN_LOCONET_FROM_LAN not to the client!
+
+			break;
+		}
+		case (LAN_LOCONET_DISPATCH_ADDR): {
+			if (Handler::hasLNdispatch()) {
+				data[0] = packet[4];
+				data[1] = packet[5];
+				data[2] = Handler::LNdispatch(word(packet[5], packet[4]));	//dispatchSlot
+				EthSend(client, 0x07, LAN_LOCONET_DISPATCH_ADDR, data, false, Z21bcNone);
+			}
+			break; }
+		case (LAN_LOCONET_DETECTOR):
+			  Handler::LNdetector(client, packet[4], word(packet[6], packet[5]));	//Anforderung Typ & Reportadresse
+			break;
+		#endif
+		#if !defined(Z21NOCAN)
+		case (LAN_CAN_DETECTOR):
+			Handler::CANdetector(client, packet[4], word(packet[6], packet[5]));	//Anforderung Typ & CAN-ID
+			break;
+		#endif
+		#if !defined(Z21NOCONFIG)
+		case (0x12): 	//configuration read
+			// <-- 04 00 12 00 	
+			// 0e 00 12 00 01 00 01 03 01 00 03 00 00 00
+			for (byte i = 0; i < 10; i++) {
+				data[i] = FSTORAGE.read(CONF1STORE+i);
+			}
+			EthSend(client, 0x0e, 0x12, data, false, Z21bcNone);
+			break;
+		case (0x13): {	//configuration write
+			//<-- 0e 00 13 00 01 00 01 03 01 00 03 00 00 00 
+			//0x0e = Length; 0x12 = Header
+			/* Daten:
+			(0x01) RailCom: 0=aus/off, 1=ein/on
+			(0x00)
+			(0x01) Power-Button: 0=Gleisspannung aus, 1=Nothalt
+			(0x03) Auslese-Modus: 0=Nichts, 1=Bit, 2=Byte, 3=Beides
+			*/
+			
+			for (byte i = 0; i < 10; i++) {
+				FSTORAGE.FSTORAGEMODE(CONF1STORE+i,packet[4+i]);
+			}
+			/*
+			#if defined(ESP8266) || defined(ESP32)
+			FSTORAGE.commit();
+			#endif
+			*/
+			//Request DCC to change
+			Handler::UpdateConf();
+			break;
+		}
+		case (0x16):  //configuration read
+			//<-- 04 00 16 00 
+			//14 00 16 00 19 06 07 01 05 14 88 13 10 27 32 00 50 46 20 4e 
+			for (byte i = 0; i < 16; i++) {
+				data[i] = FSTORAGE.read(CONF2STORE+i);
+			}
+			
+			//check range of MainV:
+			if ((word(data[13],data[12]) > 0x59D8) || (word(data[13],data[12]) < 0x2A8F)) {
+				//set to 20V default:
+				data[13] = highByte(0x4e20);
+				data[12] = lowByte(0x4e20);
+			}
+			//check range of ProgV:
+			if ((word(data[15],data[14]) > 0x59D8) || (word(data[15],data[14]) < 0x2A8F)) {
+				//set to 20V default:
+				data[15] = highByte(0x4e20);
+				data[14] = lowByte(0x4e20);
+			}
+			
+			EthSend(client, 0x14, 0x16, data, false, Z21bcNone);
+			break;
+		case (0x17): {	//configuration write
+			//<-- 14 00 17 00 19 06 07 01 05 14 88 13 10 27 32 00 50 46 20 4e 
+			//0x14 = Length; 0x16 = Header(read), 0x17 = Header(write)
+			/* Daten:
+			(0x19) Reset Packet (starten) (25-255)
+			(0x06) Reset Packet (fortsetzen) (6-64)
+			(0x07) Programmier-Packete (7-64)
+			(0x01) ?
+			(0x05) ?
+			(0x14) ?
+			(0x88) ?
+			(0x13) ?
+			(0x10) ?
+			(0x27) ?
+			(0x32) ?
+			(0x00) ?
+			(0x50) Hauptgleis (LSB) (11-23V)
+			(0x46) Hauptgleis (MSB)
+			(0x20) Programmiergleis (LSB) (11-23V): 20V=0x4e20, 21V=0x5208, 22V=0x55F0
+			(0x4e) Programmiergleis (MSB)
+			*/
+			for (byte i = 0; i < 16; i++) {
+				FSTORAGE.FSTORAGEMODE(CONF2STORE+i,packet[4+i]);
+			}
+			/*
+			#if defined(ESP8266) || defined(ESP32)
+			FSTORAGE.commit();
+			#endif
+			*/
+			//Request DCC to change
+			Handler::UpdateConf();
+			break;
+		}
+		#endif
+		#if defined(Z21STATS)
+		case (LAN_DIAG_GETSTATS):
+			returnStats(client, packet[4]);
+			break;
+		#endif
+		default:
+		  #if defined(Z21STATS)
+		  Stats.rxUnknown++;
+		  #endif
+		  data[0] = 0x61;
+		  data[1] = 0x82;
+		  EthSend (client, 0x07, LAN_X_Header, data, true, Z21bcNone);
+		}
+	//---------------------------------------------------------------------------------------
+	#if defined(Z21STATS)
+	if (slot < z21clientMAX) {
+		Stats.clientRx[slot]++;
+		Stats.clientTime[slot] += timer.time();
+	}
+	#endif
+	tick();
+}
+
+//--------------------------------------------------------------------------------------------
+//Timeouts and client activity
+template <class Handler>
+void z21Base<Handler>::tick() 
+{
+	#if defined(Z21EVENTQUEUE)
+	//results of the DCC task:
+	byte tail = CVResultTail;
+	while (tail != z21AtomicLoad(CVResultHead)) {
+		TypeZ21CVResult r = CVResult[tail & (z21CVResultMAX - 1)];
+		tail++;
+		z21AtomicStore(CVResultTail, tail);	//free the slot for the DCC task
+		returnCVResult(r.type, r.adr, r.cv, r.value);
+	}
+	#endif
+	
+	//check if the CV request get no answer:
+	if ((CVReq[0].type & z21CVReqStarted) && (millis() - CVReq[0].time > z21CVTimeout)) {
+		byte data[2];
+		data[0] = LAN_X_CV_NACK;  //0x61 X-Header
+		data[1] = 0x13; //DB0
+		returnCVReq(0, 0x07, data);
+		removeCVReq(0);
+	}
+	
+	//check if IP is still used:
+	unsigned long currentMillis = millis();
+	if ((currentMillis - z21IPpreviousMillis) > z21IPinterval) {
+		z21IPpreviousMillis = currentMillis;   
+		for (byte i = 0; i < z21clientMAX; i++) {
+			if (ActIP[i].time > 0) {
+				ActIP[i].time--;    //Zeit herrunterrechnen
+			}
+			else {
+				clearIP(i); 	//clear IP DATA
+				//send MESSAGE clear Client
+			}
+		} 
+	}
+	
+	#if defined(Z21SENDQUEUE)
+	//send the queued messages to the clients that are ready again:
+	if (Handler::hasEthReady()) {
+		for (byte i = 0; i < z21clientMAX; i++) {
+			if (SendQueue[i].count > 0)
+				queueFlush(i);
+		}
+	}
+	#endif
+	
+	#if defined(Z21ACCQUEUE)
+	if (AccRoute)
+		accRun();	//coils off, next turnouts
+	#endif
+	
+	#if defined(Z21PERSIST)
+	if (Handler::hasPersist())
+		persistTick();	//store the changes
+	#endif
+	
+	#if defined(Z21SYSINFO)
+	sysInfoRun();	//state changed or max. interval
+	#endif
+}
+
+#if defined(Z21PERSIST)
+//--------------------------------------------------------------------------------------------
+//restore power, clients, locos and turnouts of the stored state, blocks with a wrong CRC are skipped
+template <class Handler>
+bool z21Base<Handler>::begin() {
+	byte data[z21PersistBlock];
+	if (!Handler::PersistRead(0, data, z21PersistBlock) || word(data[1], data[0]) != persistCRC(0, data + 2))
+		return false;	//nothing stored
+	if (data[2] != 'Z' || data[3] != 'S' || data[4] != z21PersistVersion || data[5] != z21clientMAX ||
+		data[6] != z21PersistBlocks - 1 - z21clientMAX - z21PersistTrnt || data[7] != z21PersistTrnt)
+		return false;	//other version or size of the tables
+	PersistCRC[0] = word(data[1], data[0]);
+	for (uint16_t i = 1; i < z21PersistBlocks; i++) {
+		if (Handler::PersistRead(i * z21PersistBlock, data, z21PersistBlock) && word(data[1], data[0]) == persistCRC(i, data + 2)) {
+			persistRestore(i, data + 2);
+			PersistCRC[i] = word(data[1], data[0]);
+		}
+	}
+	endpointRebuild();
+	if (Handler::PersistRead(0, data, z21PersistBlock))
+		persistRestore(0, data + 2);	//power at last
+	return true;
+}
+#endif
+
+#if defined(Z21ACCQUEUE)
+//--------------------------------------------------------------------------------------------
+//ms of a coil and max. coils that are on at once (booster current)
+template <class Handler>
+void z21Base<Handler>::setAccPulse(uint16_t pulse, byte active) {
+	AccPulse = pulse;
+	if (active < 1)
+		active = 1;
+	else if (active > z21AccActiveMAX)
+		active = z21AccActiveMAX;
+	AccActiveLimit = active;
+}
+
+//--------------------------------------------------------------------------------------------
+//ms of the last route: first queued command until the last coil is off
+template <class Handler>
+unsigned long z21Base<Handler>::getAccSettle() {
+	return AccSettle;
+}
+#endif
+
+//--------------------------------------------------------------------------------------------
+//Zustand der Gleisversorgung setzten
+template <class Handler>
+void z21Base<Handler>::setPower(byte state) 
+{
+	Railpower = state;
+	returnPower(0);
+	#if defined(Z21STATE)
+	State->setPower(state);
+	State->changedPower(this, state);
+	#endif
+	#if defined(SERIALDEBUG)
+	ZDebug.print("set_X_BC_TRACK_POWER ");
+	ZDebug.println(state, HEX);
+	#endif
+}
+  
+//--------------------------------------------------------------------------------------------
+//Abfrage letzte Meldung über Gleispannungszustand
+template <class Handler>
+byte z21Base<Handler>::getPower() 
+{
+	return Railpower;
+}
+
+#if defined(Z21STATE)
+//--------------------------------------------------------------------------------------------
+//state tables for other tasks
+template <class Handler>
+z21StateClass &z21Base<Handler>::getState() 
+{
+	return *State;
+}
+
+//--------------------------------------------------------------------------------------------
+//use the state of an other z21Class, the changes go to the clients of both
+template <class Handler>
+void z21Base<Handler>::attach(z21StateClass &core) 
+{
+	State = &core;
+	State->attach(this);
+	Railpower = State->getPower();
+}
+
+//--------------------------------------------------------------------------------------------
+//changes of the other Front-Ends, only to the own clients
+template <class Handler>
+void z21Base<Handler>::statePower(byte state) 
+{
+	Railpower = state;
+	returnPower(0);
+}
+
+template <class Handler>
+void z21Base<Handler>::stateLoco(uint16_t Adr) 
+{
+	reqLocoBusy(Adr);
+	#if defined(Z21EVENTQUEUE)
+	returnLocoStateFull(0, Adr, true, true);	//the shared state is newer than the DCC task
+	#else
+	returnLocoStateFull(0, Adr, true);
+	#endif
+}
+
+template <class Handler>
+void z21Base<Handler>::stateTrnt(uint16_t Adr, bool State) 
+{
+	returnTrntInfo(Adr, State);
+}
+
+template <class Handler>
+void z21Base<Handler>::stateExtACC(uint16_t Adr, byte State, byte Status) 
+{
+	if ((Status == 0x00) && !storeExtACC(Adr, State))
+		return;	//Zustand unverändert, kein Broadcast
+	returnExtACCInfo(0, Adr, State, Status);
+}
+
+template <class Handler>
+void z21Base<Handler>::stateS88(byte *data) 
+{
+	EthSend(0, 0x0F, LAN_RMBUS_DATACHANGED, data, false, Z21bcRBus); //RMBUS_DATACHANED
+}
+#endif
+
+//--------------------------------------------------------------------------------------------
+//return request for POM read byte
+template <class Handler>
+void z21Base<Handler>::setCVPOMBYTE (uint16_t CVAdr, uint8_t value) {
+	cvResult(z21CVResultPOMAny, 0, CVAdr, value);
+}
+
+//--------------------------------------------------------------------------------------------
+//return request for POM read byte of the loco/accessory
+template <class Handler>
+void z21Base<Handler>::setCVPOMBYTE (uint16_t Adr, uint16_t CVAdr, uint8_t value) {
+	cvResult(z21CVResultPOM, Adr, CVAdr, value);
+}
+
+//--------------------------------------------------------------------------------------------
+//Zustand Rückmeldung non - Z21 device - Busy!
+template <class Handler>
+void z21Base<Handler>::setLocoStateExt (int Adr) 
+{
+/*	uint8_t ldata[6];
+	Handler::LocoState(Adr, ldata); //uint8_t Steps[0], uint8_t Speed[1], uint8_t F0[2], uint8_t F1[3], uint8_t F2[4], uint8_t F3[5]
+	
+	byte data[10]; 
+	data[0] = LAN_X_LOCO_INFO;  //0xEF X-HEADER
+	data[1] = (Adr >> 8) & 0x3F;
+	data[2] = Adr & 0xFF;
+	// Fahrstufeninformation: 0=14, 2=28, 4=128 
+	if ((ldata[0] & 0x03) == DCCSTEP14)
+		data[3] = 0;	// 14 steps
+	if ((ldata[0] & 0x03) == DCCSTEP28)
+		data[3] = 2;	// 28 steps
+	if ((ldata[0] & 0x03) == DCCSTEP128)		
+		data[3] = 4;	// 128 steps
+	data[3] = data[3] | 0x08; //BUSY!
+		
+	data[4] = (char) ldata[1];	//DSSS SSSS
+	data[5] = (char) ldata[2] & 0x1F;    //F0, F4, F3, F2, F1
+	data[6] = (char) ldata[3];    //F5 - F12; Funktion F5 ist bit0 (LSB)
+	data[7] = (char) ldata[4];  //F13-F20
+	data[8] = (char) ldata[5];  //F21-F28
+	data[9] = (char) ldata[8] >> 7;	//F31-F29 only
+*/
+	reqLocoBusy(Adr);
+	
+	returnLocoStateFull(0, Adr, true);
+	#if defined(Z21STATE)
+	State->changedLoco(this, Adr);
+	#endif
+	
+	//EthSend(0, 15, LAN_X_Header, data, true, Z21bcAll | Z21bcNetAll);  //Send Loco Status und Funktions to all active Apps 
+}
+
+//--------------------------------------------------------------------------------------------
+//Gibt aktuellen Lokstatus an Anfragenden Zurück
+template <class Handler>
+void z21Base<Handler>::returnLocoStateFull (byte client, uint16_t Adr, bool bc, bool pending, byte db0, byte db3) 
+//bc = true => to inform also other client over the change.
+//bc = false => just ask about the loco state
+//pending = true => the DCC task has not the command yet, Z21STATE has it or DB0/DB3 change the data of the hook
+{
+	if (Adr == 0) {
+		//Not a valid loco adr!
+		return;
+	}
+	
+	uint8_t ldata[6];
+	bool known = false;
+	#if defined(Z21STATE)
+	known = pending && State->getLoco(Adr, ldata);
+	#endif
+	if (!known && Handler::hasLocoState()) {
+		Handler::LocoState(Adr, ldata); //uint8_t Steps[0], uint8_t Speed[1], uint8_t F0[2], uint8_t F1[3], uint8_t F2[4], uint8_t F3[5]
+		if (pending)
+			z21StateClass::locoCommand(ldata, db0, db3);	//not yet applied by the DCC task
+		#if defined(Z21STATE)
+		State->setLoco(Adr, ldata);
+		#endif
+	}
+	#if defined(Z21STATE)
+	else if (!known && !State->getLoco(Adr, ldata)) {	//unknown loco
+		ldata[0] = DCCSTEP128;
+		for (byte i = 1; i < 6; i++)
+			ldata[i] = 0;
+	}
+	#endif
+	
+	byte data[10]; 
+	data[0] = LAN_X_LOCO_INFO;  //0xEF X-HEADER
+	data[1] = (Adr >> 8) & 0x3F;
+	data[2] = Adr & 0xFF;
+	// Fahrstufeninformation: 0=14, 2=28, 4=128 
+	if ((ldata[0] & 0x03) == DCCSTEP14)
+		data[3] = 0;	// 14 steps
+	if ((ldata[0] & 0x03) == DCCSTEP28)
+		data[3] = 2;	// 28 steps
+	if ((ldata[0] & 0x03) == DCCSTEP128)		
+		data[3] = 4;	// 128 steps
+	data[3] = data[3] | 0x08; //BUSY!
+		
+	data[4] = (char) ldata[1];	//DSSS SSSS
+	data[5] = (char) ldata[2] & 0x1F;  //F0, F4, F3, F2, F1
+	data[6] = (char) ldata[3];  //F5 - F12; Funktion F5 ist bit0 (LSB)
+	data[7] = (char) ldata[4];  //F13-F20
+	data[8] = (char) ldata[5];  //F21-F28
+	data[9] = (char) ldata[2] >> 7; 	//F31-F29
+	
+	//Info to all:
+	for (byte i = 0; i < z21clientMAX; i++) {
+		if (ActIP[i].client != client) {
+			if ((ActIP[i].BCFlag & (Z21bcAll | Z21bcNetAll)) > 0) {
+				if (bc == true)
+					EthSend (ActIP[i].client, 15, LAN_X_Header, data, true, Z21bcNone);  //Send Loco status und Funktions to BC Apps
+			}
+		}
+		else { //Info to client that ask:
+			if (ActIP[i].adr == Adr) {
+				data[3] = data[3] & 0b111;	//clear busy flag!
+			}
+			EthSend (client, 15, LAN_X_Header, data, true, Z21bcNone);  //Send Loco status und Funktions to request App
+			data[3] = data[3] | 0x08; //BUSY!
+		}
+	}
+	
+}
+
+
+
+//--------------------------------------------------------------------------------------------
+//return state of S88 sensors
+template <class Handler>
+void z21Base<Handler>::setS88Data(byte *data) {	
+	EthSend(0, 0x0F, LAN_RMBUS_DATACHANGED, data, false, Z21bcRBus); //RMBUS_DATACHANED
+	#if defined(Z21STATE)
+	State->changedS88(this, data);
+	#endif
+}
+
+#if !defined(Z21NOLOCONET)
+//--------------------------------------------------------------------------------------------
+//return state from LN detector
+template <class Handler>
+void z21Base<Handler>::setLNDetector(uint8_t client, byte *data, byte DataLen) {
+	if (client > 0)
+		EthSend(client, 0x04 + DataLen, LAN_LOCONET_DETECTOR, data, false, Z21bcNone);  //LAN_LOCONET_DETECTOR
+	else EthSend(0, 0x04 + DataLen, LAN_LOCONET_DETECTOR, data, false, Z21bcLocoNet | Z21bcLocoNetGBM);  //LAN_LOCONET_DETECTOR, like LNclassSensor
+}
+
+//--------------------------------------------------------------------------------------------
+//LN Meldungen weiterleiten
+template <class Handler>
+bool z21Base<Handler>::setLNMessage(byte *data, byte DataLen, byte bcType, bool TX) {
+	if (DataLen > 20)	//Z21 LocoNet tunnel DATA has max 20 Byte!
+		return false;
+	if (TX)   //Send by Z21 or Receive a Packet?
+		EthSend(0, 0x04 + DataLen, LAN_LOCONET_Z21_TX, data, false, bcType);  //LAN_LOCONET_Z21_TX
+	else EthSend(0, 0x04 + DataLen, LAN_LOCONET_Z21_RX, data, false, bcType);  //LAN_LOCONET_Z21_RX
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------
+//LN Meldungen weiterleiten, BC-Flag nach Opcode (Loks, Weichen, Belegtmelder)
+template <class Handler>
+bool z21Base<Handler>::setLNMessage(byte *data, byte DataLen, bool TX) {
+	if (DataLen > 20)	//Z21 LocoNet tunnel DATA has max 20 Byte!
+		return false;
+	if (TX)   //Send by Z21 or Receive a Packet?
+		EthSendLN(0, 0x04 + DataLen, LAN_LOCONET_Z21_TX, data);  //LAN_LOCONET_Z21_TX
+	else EthSendLN(0, 0x04 + DataLen, LAN_LOCONET_Z21_RX, data);  //LAN_LOCONET_Z21_RX
+	return true;
+}
+#endif
+
+#if !defined(Z21NOCAN)
+//--------------------------------------------------------------------------------------------
+//return state from CAN detector
+template <class Handler>
+void z21Base<Handler>::setCANDetector(uint16_t NID, uint16_t Adr, uint8_t port, uint8_t typ, uint16_t v1, uint16_t v2) {
+	byte data[10];
+	data[0] = NID & 0xFF;
+	data[1] = NID >> 8;
+	data[2] = Adr & 0xFF;
+	data[3] = Adr >> 8;
+	data[4] = port;
+	data[5] = typ;
+	data[6] = v1 & 0xFF;
+	data[7] = v1 >> 8;
+	data[8] = v2 & 0xFF;
+	data[9] = v2 >> 8;
+	EthSend(0, 0x0E, LAN_CAN_DETECTOR, data, false, Z21bcCANDetector);  //CAN_DETECTOR
+}
+#endif
+
+//--------------------------------------------------------------------------------------------
+//Return the state of accessory
+template <class Handler>
+void z21Base<Handler>::setTrntInfo(uint16_t Adr, bool State) {
+	returnTrntInfo(Adr, State);
+	#if defined(Z21STATE)
+	this->State->setTrnt(Adr, State);
+	this->State->changedTrnt(this, Adr, State);
+	#endif
+}
+
+//--------------------------------------------------------------------------------------------
+//Return EXT accessory info
+template <class Handler>
+void z21Base<Handler>::setExtACCInfo(uint16_t Adr, byte State, byte Status) {
+	if ((Status == 0x00) && !storeExtACC(Adr, State))
+		return;	//Zustand unverändert, kein Broadcast
+	returnExtACCInfo(0, Adr, State, Status);
+	#if defined(Z21STATE)
+	this->State->changedExtACC(this, Adr, State, Status);
+	#endif
+}
+
+//--------------------------------------------------------------------------------------------
+//Return CV Value for Programming
+template <class Handler>
+void z21Base<Handler>::setCVReturn (uint16_t CV, uint8_t value) {
+	cvResult(z21CVResultReturn, 0, CV, value);
+}
+
+//--------------------------------------------------------------------------------------------
+//Return no ACK from Decoder
+template <class Handler>
+void z21Base<Handler>::setCVNack() {
+	cvResult(z21CVResultNack, 0, 0, 0);
+}
+
+//--------------------------------------------------------------------------------------------
+//Return Short while Programming
+template <class Handler>
+void z21Base<Handler>::setCVNackSC() {
+	cvResult(z21CVResultNackSC, 0, 0, 0);
+}
+
+//--------------------------------------------------------------------------------------------
+//result of the DCC task: with Z21EVENTQUEUE tick() answer the clients (the CV requests belong to receive())
+template <class Handler>
+void z21Base<Handler>::cvResult(byte type, uint16_t Adr, uint16_t CV, byte value) {
+	#if defined(Z21EVENTQUEUE)
+	byte head = CVResultHead;
+	if ((byte)(head - z21AtomicLoad(CVResultTail)) >= z21CVResultMAX)
+		return;		//full, the request get the timeout
+	TypeZ21CVResult &r = CVResult[head & (z21CVResultMAX - 1)];
+	r.type = type;
+	r.adr = Adr;
+	r.cv = CV;
+	r.value = value;
+	z21AtomicStore(CVResultHead, (byte)(head + 1));	//publish for tick()
+	#else
+	returnCVResult(type, Adr, CV, value);
+	#endif
+}
+
+//--------------------------------------------------------------------------------------------
+//answer the request clients (or all) and start the next CV request
+template <class Handler>
+void z21Base<Handler>::returnCVResult(byte type, uint16_t Adr, uint16_t CV, byte value) {
+	byte data[5];
+	byte pos = z21CVReqMAX;
+	switch (type) {
+		case z21CVResultNack:
+		case z21CVResultNackSC:
+			data[0] = (type == z21CVResultNack) ? LAN_X_CV_NACK : LAN_X_CV_NACK_SC;  //0x61 X-Header
+			data[1] = (type == z21CVResultNack) ? 0x13 : 0x12; //DB0
+			if (CVReq[0].type & z21CVReqStarted) {	//only to the request clients
+				returnCVReq(0, 0x07, data);
+				removeCVReq(0);
+			}
+			else EthSend (0, 0x07, LAN_X_Header, data, true, Z21bcAll);
+			return;
+		case z21CVResultReturn:
+			pos = findCVReq(z21CVReqRead, 0, CV);
+			if (pos == z21CVReqMAX)
+				pos = findCVReq(z21CVReqWrite, 0, CV);
+			data[2] = CV >> 8;  //CV_MSB;
+			break;
+		case z21CVResultPOMAny:
+			pos = findCVReq(z21CVReqPOMRead, 0, CV);
+			#if !defined(Z21NOPOMACC)
+			if (pos == z21CVReqMAX)
+				pos = findCVReq(z21CVReqPOMACCRead, 0, CV);
+			#endif
+			Adr = (pos < z21CVReqMAX) ? CVReq[pos].adr : 0;
+			//fall through
+		case z21CVResultPOM:
+			pos = findCVReq(z21CVReqPOMRead, Adr, CV);
+			#if !defined(Z21NOPOMACC)
+			if (pos == z21CVReqMAX)
+				pos = findCVReq(z21CVReqPOMACCRead, Adr, CV);
+			#endif
+			data[2] = (CV >> 8) & 0x3F;  //CV_MSB;
+			break;
+		default:
+			return;
+	}
+	data[0] = LAN_X_CV_RESULT;   //0x64 X-Header
+	data[1] = 0x14; //DB0
+	data[3] = CV & 0xFF; //CV_LSB;
+	data[4] = value;
+	if (pos < z21CVReqMAX) {	//only to the request clients
+		returnCVReq(pos, 0x0A, data);
+		removeCVReq(pos);
+	}
+	else EthSend (0, 0x0A, LAN_X_Header, data, true, Z21bcAll);
+}
+
+//--------------------------------------------------------------------------------------------
+//Send Changing of SystemInfo
+template <class Handler>
+void z21Base<Handler>::sendSystemInfo(byte client, uint16_t maincurrent, uint16_t mainvoltage, uint16_t temp) {
+	#if defined(Z21SYSINFO)
+	setSystemInfo(maincurrent, mainvoltage, temp, SysInfo.stateEx);	//to all only by the scheduler
+	if (client > 0)
+		returnSystemInfo(client, maincurrent, SysInfo.filtered >> z21SysInfoFilter, mainvoltage, temp, SysInfo.stateEx);
+	#else
+	returnSystemInfo(client, maincurrent, maincurrent, mainvoltage, temp, 0x00);
+	#endif
+}
+
+#if defined(Z21SYSINFO)
+//--------------------------------------------------------------------------------------------
+//raw sample of the command station, FilteredMainCurrent is a moving average
+template <class Handler>
+void z21Base<Handler>::setSystemInfo(uint16_t maincurrent, uint16_t mainvoltage, uint16_t temp, byte stateEx) {
+	if (!SysInfo.valid)
+		SysInfo.filtered = (uint32_t) maincurrent << z21SysInfoFilter;
+	else SysInfo.filtered += maincurrent - (SysInfo.filtered >> z21SysInfoFilter);
+	SysInfo.current = maincurrent;
+	SysInfo.voltage = mainvoltage;
+	SysInfo.temp = temp;
+	SysInfo.stateEx = stateEx;
+	SysInfo.valid = true;
+	sysInfoRun();
+}
+
+//--------------------------------------------------------------------------------------------
+//min. and max. ms between two LAN_SYSTEMSTATE_DATACHANGED, change of the values for a message
+template <class Handler>
+void z21Base<Handler>::setSystemInfoRate(uint16_t minTime, uint16_t maxTime, uint16_t bandCurrent, uint16_t bandVoltage) {
+	SysInfo.minTime = minTime;
+	SysInfo.maxTime = (maxTime < minTime) ? minTime : maxTime;
+	SysInfo.bandCurrent = bandCurrent;
+	SysInfo.bandVoltage = bandVoltage;
+}
+
+//--------------------------------------------------------------------------------------------
+//CentralState and CentralStateEx at once, the values not faster than minTime
+template <class Handler>
+void z21Base<Handler>::sysInfoRun() {
+	if (!SysInfo.valid)
+		return;
+	unsigned long now = millis();
+	uint16_t filtered = SysInfo.filtered >> z21SysInfoFilter;
+	bool send = (Railpower != SysInfo.sentState) || (SysInfo.stateEx != SysInfo.sentStateEx);
+	if (!send && (now - SysInfo.sentTime >= SysInfo.minTime)) {
+		send = (now - SysInfo.sentTime >= SysInfo.maxTime)
+			|| ((filtered > SysInfo.sentCurrent ? filtered - SysInfo.sentCurrent : SysInfo.sentCurrent - filtered) >= SysInfo.bandCurrent)
+			|| ((SysInfo.voltage > SysInfo.sentVoltage ? SysInfo.voltage - SysInfo.sentVoltage : SysInfo.sentVoltage - SysInfo.voltage) >= SysInfo.bandVoltage)
+			|| ((SysInfo.temp > SysInfo.sentTemp ? SysInfo.temp - SysInfo.sentTemp : SysInfo.sentTemp - SysInfo.temp) >= z21SysInfoBandTemp);
+	}
+	if (!send)
+		return;
+	SysInfo.sentCurrent = filtered;
+	SysInfo.sentVoltage = SysInfo.voltage;
+	SysInfo.sentTemp = SysInfo.temp;
+	SysInfo.sentState = Railpower;
+	SysInfo.sentStateEx = SysInfo.stateEx;
+	SysInfo.sentTime = now;
+	returnSystemInfo(0, SysInfo.current, filtered, SysInfo.voltage, SysInfo.temp, SysInfo.stateEx);
+}
+#endif
+
+//--------------------------------------------------------------------------------------------
+//LAN_SYSTEMSTATE_DATACHANGED to the client or (client = 0) to all with Z21bcSystemInfo
+template <class Handler>
+void z21Base<Handler>::returnSystemInfo(byte client, uint16_t maincurrent, uint16_t filtered, uint16_t mainvoltage, uint16_t temp, byte stateEx) {
+	byte data[16];
+	data[0] = maincurrent & 0xFF;  //MainCurrent mA
+	data[1] = maincurrent >> 8;  //MainCurrent mA
+	data[2] = data[0];  //ProgCurrent mA
+	data[3] = data[1];  //ProgCurrent mA        
+	data[4] = filtered & 0xFF;  //FilteredMainCurrent
+	data[5] = filtered >> 8;  //FilteredMainCurrent
+	data[6] = temp & 0xFF;  //Temperature
+	data[7] = temp >> 8;  //Temperature
+	data[8] = mainvoltage & 0xFF;  //SupplyVoltage
+	data[9] = mainvoltage >> 8;  //SupplyVoltage
+	data[10] = data[8];  //VCCVoltage
+	data[11] = data[9];  //VCCVoltage
+	data[12] = Railpower;  //CentralState
+	if (data[12] == csServiceMode)
+		data[12] = 0x20;
+/*Bitmasken für CentralState: 
+	#define csEmergencyStop  0x01 // Der Nothalt ist eingeschaltet 
+	#define csTrackVoltageOff  0x02 // Die Gleisspannung ist abgeschaltet 
+	#define csShortCircuit  0x04 // Kurzschluss 
+	#define csProgrammingModeActive 0x20 // Der Programmiermodus ist aktiv 	
+*/	
+	data[13] = stateEx;  //CentralStateEx
+/* Bitmasken für CentralStateEx: 
+	#define cseHighTemperature  0x01 // zu hohe Temperatur 
+	#define csePowerLost  0x02 // zu geringe Eingangsspannung 
+	#define cseShortCircuitExternal 0x04 // am externen Booster-Ausgang 
+	#define cseShortCircuitInternal 0x08 // am Hauptgleis oder Programmiergleis 
+	#define cseRCN213 0x20 // Weichenadressierung gem. RCN213	
+*/	
+	data[14] = 0x00;  //reserved
+	data[15] = 0x01;  //Capabilitie DCC only
+	if (FSTORAGE.read(CONF1STORE) == 0x01)	//RailCom
+		data[15] |= 0x08;	//RailCom aktiv!
+	data[15] |=	0x10 | 0x20 | 0x40;		//LAN-Befehle 	
+/*	
+	#define capDCC 0x01 // beherrscht DCC
+	#define capMM 0x02 // beherrscht MM
+	//#define capReserved 0x04 // reserviert für zukünftige Erweiterungen
+	#define capRailCom 0x08 // RailCom ist aktiviert
+	#define capLocoCmds 0x10 // akzeptiert LAN-Befehle für Lokdecoder
+	#define capAccessoryCmds 0x20 // akzeptiert LAN-Befehle für Zubehördecoder
+	#define capDetectorCmds 0x40 // akzeptiert LAN-Befehle für Belegtmelder
+	#define capNeedsUnlockCode 0x80 // benötigt Freischaltcode (z21start)
+*/	
+	//only to the request client if or if client = 0 to all that select this message (Abo)!
+	if (client > 0)
+		EthSend (client, 0x14, LAN_SYSTEMSTATE_DATACHANGED, data, false, Z21bcNone);	
+	else EthSend (0, 0x14, LAN_SYSTEMSTATE_DATACHANGED, data, false, Z21bcSystemInfo);
+}			  
+
+#if defined(Z21STATS)
+//--------------------------------------------------------------------------------------------
+//read the statistic
+template <class Handler>
+const TypeZ21Stats *z21Base<Handler>::getStats() {
+	return &Stats;
+}
+
+//--------------------------------------------------------------------------------------------
+//reset the statistic
+template <class Handler>
+void z21Base<Handler>::clearStats() {
+	memset(&Stats, 0, sizeof(Stats));
+}
+#endif
+
+#if defined(Z21EVENTQUEUE)
+//--------------------------------------------------------------------------------------------
+//notify all DCC commands that receive() has stored, only one task may call this!
+template <class Handler>
+byte z21Base<Handler>::poll() {
+	byte count = 0;
+	byte tail = EventTail;
+	while (true) {
+		byte seq = z21AtomicLoad(EventPowerSeq);
+		if (seq != EventPowerDone) {	//power and stop before the older commands
+			EventPowerDone = seq;
+			TypeZ21Event ev;
+			ev.type = z21EventRailPower;
+			ev.data[0] = z21AtomicLoad(EventPower);
+			callEvent(ev);
+			count++;
+			continue;
+		}
+		if (tail == z21AtomicLoad(EventHead))
+			break;
+		TypeZ21Event ev = Event[tail & (z21EventMAX - 1)];
+		tail++;
+		z21AtomicStore(EventTail, tail);	//free the slot for receive()
+		callEvent(ev);
+		count++;
+	}
+	return count;
+}
+#endif
+
+#if defined(Z21TRACE)
+//--------------------------------------------------------------------------------------------
+//get the oldest trace record, false if there is nothing to read
+//only one reader! Records that are overwritten before they are read will be counted as lost.
+template <class Handler>
+bool z21Base<Handler>::traceRead(TypeZ21Trace &rec) {
+	unsigned int head = z21AtomicLoad(TraceHead);
+	while (TraceTail != head) {
+		if ((unsigned int)(head - TraceTail) > z21TraceMAX) {	//writer was faster
+			TraceLost += (unsigned int)(head - TraceTail) - z21TraceMAX;
+			TraceTail = head - z21TraceMAX;
+		}
+		TypeZ21Trace *t = &Trace[TraceTail & (z21TraceMAX - 1)];
+		unsigned int done = (TraceTail << 1) + 2;	//seq of the finished record
+		unsigned int seq = z21AtomicLoad(t->seq);
+		if ((int)(seq - done) < 0)	//still writing
+			return false;
+		if (seq == done) {
+			rec = *t;
+			z21AtomicFence();
+			if (z21AtomicLoad(t->seq) == done) {	//not changed while reading
+				TraceTail++;
+				return true;
+			}
+		}
+		TraceLost++;	//overwritten by a newer record
+		TraceTail++;
+		head = z21AtomicLoad(TraceHead);
+	}
+	return false;
+}
+
+//--------------------------------------------------------------------------------------------
+//print all trace records, call inside loop()
+template <class Handler>
+void z21Base<Handler>::traceDrain(Print &out) {
+	TypeZ21Trace rec;
+	while (traceRead(rec)) {
+		out.print(rec.time);
+		out.print(rec.dir == z21TraceRX ? " RX " : (rec.dir == z21TraceTX ? " TX " : " BC "));
+		out.print(rec.client);
+		out.print(" 0x");
+		out.print(rec.header, HEX);
+		out.print(" (");
+		out.print(rec.len);
+		out.print("):");
+		for (byte i = 0; i < z21TraceData && i + 4 < rec.len; i++) {
+			out.print(" ");
+			out.print(rec.data[i], HEX);
+		}
+		out.println();
+	}
+	if (TraceLost > 0) {
+		out.print("lost: ");
+		out.println(TraceLost);
+		TraceLost = 0;
+	}
+}
+#endif
+
+// Private Methods ///////////////////////////////////////////////////////////////////////////////////////////////////
+// Functions only available to other functions in this library *******************************************************
+
+#if defined(Z21STATS)
+//--------------------------------------------------------------------------------------------
+//LAN_DIAG_GETSTATS: page = table (High Nibble) and part of 16 values (Low Nibble)
+//Table: 0 = rxHeader, 1 = rxXHeader, 2 = txDatagrams, 3 = txBytes, 4 = fanout, 5 = receiveTime, 
+//6 = sendTime, 7 = clientRx, 8 = clientTime, 9 = client of the slot, 10 = rxUnknown, 11 = eventLost,
+//12 = sendReplaced, 13 = sendLost, 14 = accCollapsed, 15 = accLost and accSettle
+template <class Handler>
+void z21Base<Handler>::returnStats(byte client, byte page) {
+	uint32_t *table = NULL;
+	uint16_t len = 0;
+	uint32_t clients[z21clientMAX];
+	uint32_t acc[2];
+	switch (page >> 4) {
+		case 0: table = Stats.rxHeader; len = 256; break;
+		case 1: table = Stats.rxXHeader; len = 256; break;
+		case 2: table = Stats.txDatagrams; len = 33; break;
+		case 3: table = Stats.txBytes; len = 33; break;
+		case 4: table = Stats.fanout; len = z21clientMAX+1; break;
+		case 5: table = Stats.receiveTime; len = z21StatHistMAX; break;
+		case 6: table = Stats.sendTime; len = z21StatHistMAX; break;
+		case 7: table = Stats.clientRx; len = z21clientMAX; break;
+		case 8: table = Stats.clientTime; len = z21clientMAX; break;
+		case 9: 
+			for (byte i = 0; i < z21clientMAX; i++)
+				clients[i] = ActIP[i].time > 0 ? ActIP[i].client : 0;
+			table = clients; len = z21clientMAX; break;
+		case 10: table = &Stats.rxUnknown; len = 1; break;
+		case 11: table = &Stats.eventLost; len = 1; break;
+		case 12: table = &Stats.sendReplaced; len = 1; break;
+		case 13: table = &Stats.sendLost; len = 1; break;
+		case 14: table = &Stats.accCollapsed; len = 1; break;
+		case 15:
+			acc[0] = Stats.accLost;
+			acc[1] = Stats.accSettle;
+			table = acc; len = 2; break;
+	}
+	byte data[2 + 16*4];
+	byte count = 0;
+	for (uint16_t i = (page & 0x0F) * 16; (i < len) && (count < 16); i++) {
+		data[2 + count*4] = table[i];
+		data[3 + count*4] = table[i] >> 8;
+		data[4 + count*4] = table[i] >> 16;
+		data[5 + count*4] = table[i] >> 24;
+		count++;
+	}
+	data[0] = page;
+	data[1] = count;	//0 = no more data
+	EthSend(client, 0x06 + count*4, LAN_DIAG_GETSTATS, data, false, Z21bcNone);
+}
+#endif
+
+//--------------------------------------------------------------------------------------------
+//add a CV request, the same request of other clients only get the client added
+template <class Handler>
+void z21Base<Handler>::addCVReq(byte client, byte type, uint16_t Adr, uint16_t CV, byte value) {
+	byte pos = 0;
+	for (; pos < z21CVReqMAX; pos++) {
+		if (CVReq[pos].type == 0)
+			break;	//free
+		if (((CVReq[pos].type & ~z21CVReqStarted) == type) && (CVReq[pos].adr == Adr) && (CVReq[pos].cv == CV) && (CVReq[pos].value == value)) {
+			for (byte c = 0; c < z21CVReqClientMAX; c++) {
+				if (CVReq[pos].client[c] == client)
+					return;	//already waiting
+				if (CVReq[pos].client[c] == 0) {
+					CVReq[pos].client[c] = client;
+					return;
+				}
+			}
+			break;	//no space for the client
+		}
+	}
+	if ((pos == z21CVReqMAX) || (CVReq[pos].type != 0)) {	//full, report as busy
+		byte data[2];
+		data[0] = LAN_X_CV_NACK;  //0x61 X-Header
+		data[1] = 0x13; //DB0
+		EthSend (client, 0x07, LAN_X_Header, data, true, Z21bcNone);
+		return;
+	}
+	CVReq[pos].type = type;
+	CVReq[pos].adr = Adr;
+	CVReq[pos].cv = CV;
+	CVReq[pos].value = value;
+	CVReq[pos].client[0] = client;
+	for (byte c = 1; c < z21CVReqClientMAX; c++)
+		CVReq[pos].client[c] = 0;
+	if (pos == 0)
+		startCVReq();
+}
+
+//--------------------------------------------------------------------------------------------
+//DCC command: notify now or store it for poll()
+template <class Handler>
+bool z21Base<Handler>::addEvent(byte type, uint16_t Adr, byte data0, byte data1, uint16_t CV) {
+	TypeZ21Event ev;
+	ev.type = type;
+	ev.data[0] = data0;
+	ev.data[1] = data1;
+	ev.adr = Adr;
+	ev.cv = CV;
+	#if defined(Z21EVENTQUEUE)
+	if (type == z21EventRailPower) {	//safety: not inside the ring, a newer state replace the older
+		z21AtomicStore(EventPower, data0);
+		z21AtomicStore(EventPowerSeq, (byte)(EventPowerSeq + 1));	//publish for poll()
+		return true;
+	}
+	byte head = EventHead;
+	if ((byte)(head - z21AtomicLoad(EventTail)) >= z21EventMAX) {	//full, never wait for the DCC task
+		#if defined(Z21STATS)
+		Stats.eventLost++;
+		#endif
+		return false;
+	}
+	Event[head & (z21EventMAX - 1)] = ev;
+	z21AtomicStore(EventHead, (byte)(head + 1));	//publish for poll()
+	#else
+	callEvent(ev);
+	#endif
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------
+//notify the DCC command
+template <class Handler>
+void z21Base<Handler>::callEvent(const TypeZ21Event &ev) {
+	switch (ev.type) {
+		case z21EventRailPower:
+			Handler::RailPower(ev.data[0]);
+			break;
+		case z21EventLocoSpeed:
+			Handler::LocoSpeed(ev.adr, ev.data[0], ev.data[1]);
+			break;
+		case z21EventLocoFkt:
+			Handler::LocoFkt(ev.adr, ev.data[0], ev.data[1]);
+			break;
+		case z21EventLocoFktGroup:
+			switch (ev.data[0]) {
+				case 0x20: Handler::LocoFkt0to4(ev.adr, ev.data[1] & 0x1F); break;	//0 0 0 F0 F4 F3 F2 F1
+				case 0x21: Handler::LocoFkt5to8(ev.adr, ev.data[1] & 0x0F); break;	//0 0 0 0 F8 F7 F6 F5
+				case 0x22: Handler::LocoFkt9to12(ev.adr, ev.data[1] & 0x1F); break;	//0 0 0 0 F12 F11 F10 F9
+				case 0x23: Handler::LocoFkt13to20(ev.adr, ev.data[1]); break;	//F20 F19 F18 F17 F16 F15 F14 F13
+				case 0x28: Handler::LocoFkt21to28(ev.adr, ev.data[1]); break;	//F28 F27 F26 F25 F24 F23 F22 F21
+				case 0x29: Handler::LocoFkt29to36(ev.adr, ev.data[1]); break;	//F36 F35 F34 F33 F32 F31 F30 F29
+				case 0x2A: Handler::LocoFkt37to44(ev.adr, ev.data[1]); break;	//F44 F43 F42 F41 F40 F39 F38 F37
+				case 0x2B: Handler::LocoFkt45to52(ev.adr, ev.data[1]); break;	//F52 F51 F50 F49 F48 F47 F46 F45
+				case 0x50: Handler::LocoFkt53to60(ev.adr, ev.data[1]); break;	//F60 F59 F58 F57 F56 F55 F54 F53
+				case 0x51: Handler::LocoFkt61to68(ev.adr, ev.data[1]); break;	//F68 F67 F66 F65 F64 F63 F62 F61
+			}
+			break;
+		case z21EventLocoFktExt:
+			Handler::LocoFktExt(ev.adr, ev.data[0], ev.data[1]);
+			break;
+		case z21EventAccessory:
+			Handler::Accessory(ev.adr, ev.data[0], ev.data[1]);
+			break;
+		case z21EventExtAccessory:
+			Handler::ExtAccessory(ev.adr, ev.data[0]);
+			break;
+		case z21EventPOMWriteByte:
+			Handler::CVPOMWRITEBYTE(ev.adr, ev.cv, ev.data[0]);
+			break;
+		case z21EventPOMWriteBit:
+			Handler::CVPOMWRITEBIT(ev.adr, ev.cv, ev.data[0]);
+			break;
+		#if !defined(Z21NOPOMACC)
+		case z21EventPOMACCWriteByte:
+			Handler::CVPOMACCWRITEBYTE(ev.adr, ev.cv, ev.data[0]);
+			break;
+		case z21EventPOMACCWriteBit:
+			Handler::CVPOMACCWRITEBIT(ev.adr, ev.cv, ev.data[0]);
+			break;
+		#endif
+		case z21EventCVRead:
+			Handler::CVREAD(ev.cv >> 8, ev.cv & 0xFF); //CV_MSB, CV_LSB
+			break;
+		case z21EventCVWrite:
+			Handler::CVWRITE(ev.cv >> 8, ev.cv & 0xFF, ev.data[0]); //CV_MSB, CV_LSB, value
+			break;
+		case z21EventPOMReadByte:
+			Handler::CVPOMREADBYTE(ev.adr, ev.cv);
+			break;
+		#if !defined(Z21NOPOMACC)
+		case z21EventPOMACCReadByte:
+			Handler::CVPOMACCREADBYTE(ev.adr, ev.cv);
+			break;
+		#endif
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//notify DCC about the oldest CV request
+template <class Handler>
+void z21Base<Handler>::startCVReq() {
+	while (CVReq[0].type != 0) {
+		CVReq[0].type |= z21CVReqStarted;
+		CVReq[0].time = millis();
+		switch (CVReq[0].type & ~z21CVReqStarted) {
+			case z21CVReqRead:
+				if (Handler::hasCVREAD()) {
+					addEvent(z21EventCVRead, 0, 0, 0, CVReq[0].cv);
+					return;
+				}
+				break;
+			case z21CVReqWrite:
+				if (Handler::hasCVWRITE()) {
+					addEvent(z21EventCVWrite, 0, CVReq[0].value, 0, CVReq[0].cv);
+					return;
+				}
+				break;
+			case z21CVReqPOMRead:
+				if (Handler::hasCVPOMREADBYTE()) {
+					addEvent(z21EventPOMReadByte, CVReq[0].adr, 0, 0, CVReq[0].cv);  //read byte
+					return;
+				}
+				break;
+			#if !defined(Z21NOPOMACC)
+			case z21CVReqPOMACCRead:
+				if (Handler::hasCVPOMACCREADBYTE()) {
+					addEvent(z21EventPOMACCReadByte, CVReq[0].adr, 0, 0, CVReq[0].cv);  //read byte
+					return;
+				}
+				break;
+			#endif
+		}
+		//no DCC for this request, drop it:
+		for (byte i = 1; i < z21CVReqMAX; i++)
+			CVReq[i-1] = CVReq[i];
+		CVReq[z21CVReqMAX-1].type = 0;
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//delete the request, if it was the oldest start the next one
+template <class Handler>
+void z21Base<Handler>::removeCVReq(byte pos) {
+	for (byte i = pos + 1; i < z21CVReqMAX; i++)
+		CVReq[i-1] = CVReq[i];
+	CVReq[z21CVReqMAX-1].type = 0;
+	if (pos == 0)
+		startCVReq();
+}
+
+//--------------------------------------------------------------------------------------------
+//find a started request, Adr = 0 at POM: any loco/accessory
+template <class Handler>
+byte z21Base<Handler>::findCVReq(byte type, uint16_t Adr, uint16_t CV) {
+	for (byte pos = 0; pos < z21CVReqMAX; pos++) {
+		if ((CVReq[pos].type == (type | z21CVReqStarted)) && (CVReq[pos].cv == CV) && ((Adr == 0) || (CVReq[pos].adr == Adr)))
+			return pos;
+	}
+	return z21CVReqMAX;
+}
+
+//--------------------------------------------------------------------------------------------
+//send the result of the CV request to all request clients
+template <class Handler>
+void z21Base<Handler>::returnCVReq(byte pos, unsigned int DataLen, byte *data) {
+	for (byte c = 0; c < z21CVReqClientMAX; c++) {
+		if (CVReq[pos].client[c] != 0)
+			EthSend (CVReq[pos].client[c], DataLen, LAN_X_Header, data, true, Z21bcNone);
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//EXT accessory info to the request client or (client = 0) to all
+template <class Handler>
+void z21Base<Handler>::returnExtACCInfo(byte client, uint16_t Adr, byte State, byte Status) {
+	byte data[5];
+	data[0] = LAN_X_GET_EXT_ACCESSORY_INFO;  //0x44 X-HEADER
+	data[1] = Adr >> 8;   //High
+	data[2] = Adr & 0xFF; //Low
+	data[3] = State;
+	data[4] = Status;  //0x00 = Data Valid; 0xFF = Data Unknown
+	if (client > 0)
+		EthSend(client, 0x0A, LAN_X_Header, data, true, Z21bcNone);
+	else EthSend(0, 0x0A, LAN_X_Header, data, true, Z21bcAll);
+}
+
+//--------------------------------------------------------------------------------------------
+//delete all stored EXT accessory aspects
+template <class Handler>
+void z21Base<Handler>::clearExtACC() {
+	for (byte i = 0; i < z21ExtAccMAX; i++) {
+		ExtACC[i].adr = z21ExtAccFree;
+		ExtACC[i].state = 0x00;
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//find the slot of a EXT accessory, z21ExtAccMAX = not stored
+template <class Handler>
+byte z21Base<Handler>::findExtACC(uint16_t Adr) {
+	for (byte i = 0; i < z21ExtAccProbe; i++) {
+		byte slot = (Adr + i) & (z21ExtAccMAX - 1);
+		if (ExtACC[slot].adr == Adr)
+			return slot;
+		if (ExtACC[slot].adr == z21ExtAccFree)
+			break;	//Ende der Suchfolge
+	}
+	return z21ExtAccMAX;
+}
+
+//--------------------------------------------------------------------------------------------
+//store the aspect of a EXT accessory, return true if it has changed
+template <class Handler>
+bool z21Base<Handler>::storeExtACC(uint16_t Adr, byte State) {
+	byte slot = Adr & (z21ExtAccMAX - 1);	//Suchfolge voll: ersten Platz überschreiben
+	for (byte i = 0; i < z21ExtAccProbe; i++) {
+		byte s = (Adr + i) & (z21ExtAccMAX - 1);
+		if (ExtACC[s].adr == Adr) {
+			if (ExtACC[s].state == State)
+				return false;	//keine Änderung
+			slot = s;
+			break;
+		}
+		if (ExtACC[s].adr == z21ExtAccFree) {
+			slot = s;
+			break;
+		}
+	}
+	ExtACC[slot].adr = Adr;
+	ExtACC[slot].state = State;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------
+template <class Handler>
+void z21Base<Handler>::EthSend (byte client, unsigned int DataLen, unsigned int Header, byte *dataString, boolean withXOR, unsigned long BC) {
+	byte data[DataLen]; 			//z21 send storage
+	#if defined(Z21STATS)
+	z21StatTimer timer(Stats.sendTime);
+	byte fanout = 0;
+	#endif
+	
+	//--------------------------------------------        
+	//XOR bestimmen:
+	data[0] = DataLen & 0xFF;
+	data[1] = DataLen >> 8;
+	data[2] = Header & 0xFF;
+	data[3] = Header >> 8;
+	data[DataLen - 1] = 0;	//XOR
+
+    for (byte i = 0; i < (DataLen-5+!withXOR); i++) { //Ohne Length und Header und XOR
+        if (withXOR)
+			data[DataLen-1] = data[DataLen-1] ^ *dataString;
+		data[i+4] = *dataString;
+        dataString++;
+    }
+   Handler::Capture((client > 0 && BC == Z21bcNone) ? z21TraceTX : z21TraceBC, client, data);
+   #if defined(Z21TRACE)
+   traceAdd(client, (client > 0 && BC == Z21bcNone) ? z21TraceTX : z21TraceBC, data);
+   #endif
+   //--------------------------------------------        		
+   if (client > 0 && BC == Z21bcNone) {
+		if (client == TXBufferClient) {	//collect into one datagram
+			if (TXBufferLen + DataLen > z21TXBufferSize)
+				EthBufferFlush();
+			if (DataLen <= z21TXBufferSize) {
+				memcpy(&TXBuffer[TXBufferLen], data, DataLen);
+				TXBufferLen += DataLen;
+				return;
+			}
+		}
+		#if defined(Z21SENDQUEUE)
+		byte slot = 0;
+		while (slot < z21clientMAX && ActIP[slot].client != client)
+			slot++;
+		if (Handler::hasEthReady() && slot < z21clientMAX)
+			queueSend(slot, data);
+		else
+		#endif
+		Handler::EthSend(client, data);
+		#if defined(Z21STATS)
+		Stats.txDatagrams[z21StatDirect]++;
+		Stats.txBytes[z21StatDirect] += DataLen;
+		Stats.fanout[1]++;
+		#endif
+   }
+   else {
+	byte clientOut = 0; //client;
+	for (byte i = 0; i < z21clientMAX; i++) {
+		if ( (ActIP[i].time > 0) && ( (BC & ActIP[i].BCFlag) != 0) ) {    //Boradcast & Noch aktiv
+
+		  if (BC != 0) {
+			if (BC == Z21bcAll)
+				clientOut = 0;	//ALL
+			else clientOut = ActIP[i].client;
+		  }
+		  
+		  #if defined(Z21SENDQUEUE)
+		  if (Handler::hasEthReady()) {	//each client with his own queue, BC to all include the client
+			if ((BC == Z21bcAll) || (ActIP[i].client != client)) {
+				queueSend(i, data);
+				#if defined(Z21STATS)
+				Stats.txDatagrams[__builtin_ctzl(BC)]++;
+				Stats.txBytes[__builtin_ctzl(BC)] += DataLen;
+				fanout++;
+				#endif
+			}
+			continue;
+		  }
+		  #endif
+		  
+		  if ((clientOut != client) || (clientOut == 0)) {	//wenn client > 0 und nicht Z21bcNone, sende an alle außer den client!
+		  
+			  //--------------------------------------------
+			  Handler::EthSend(clientOut, data);
+			  #if defined(Z21STATS)
+			  Stats.txDatagrams[__builtin_ctzl(BC)]++;
+			  Stats.txBytes[__builtin_ctzl(BC)] += DataLen;
+			  fanout++;
+			  if (clientOut == 0) {	//the sketch send it to all clients
+				  for (byte c = i + 1; c < z21clientMAX; c++) {
+					  if ((ActIP[c].time > 0) && ((BC & ActIP[c].BCFlag) != 0))
+						  fanout++;
+				  }
+			  }
+			  #endif
+			  if (clientOut == 0)
+				  break;
+		  }
+		}
+	}
+	#if defined(Z21STATS)
+	Stats.fanout[fanout]++;
+	#endif
+  }
+}
+
+#if defined(Z21SENDQUEUE)
+//--------------------------------------------------------------------------------------------
+//send the message if the client is ready, else queue it: a newer state replace the queued one
+template <class Handler>
+void z21Base<Handler>::queueSend(byte slot, byte *data) {
+	TypeZ21SendQueue *q = &SendQueue[slot];
+	uint16_t len = word(data[1], data[0]);
+	if (q->count > 0)
+		queueFlush(slot);	//older messages first
+	if (q->count == 0 && Handler::EthReady(ActIP[slot].client)) {
+		Handler::EthSend(ActIP[slot].client, data);
+		return;
+	}
+	if (len > z21SendQueueData) {	//too long for the queue
+		#if defined(Z21STATS)
+		Stats.sendLost++;
+		#endif
+		return;
+	}
+	uint32_t key = queueKey(data);
+	byte prio = queuePrio(data);
+	if (key != 0) {
+		for (byte i = 0; i < q->count; i++) {
+			if (q->msg[i].key == key) {	//replace at the same place
+				memcpy(q->msg[i].data, data, len);
+				q->msg[i].prio = prio;
+				#if defined(Z21STATS)
+				Stats.sendReplaced++;
+				#endif
+				return;
+			}
+		}
+	}
+	if (q->count == z21SendQueueMAX) {	//full: lose the oldest message with the lowest priority
+		byte pos = 0;
+		for (byte i = 1; i < q->count; i++) {
+			if (q->msg[i].prio > q->msg[pos].prio)
+				pos = i;
+		}
+		#if defined(Z21STATS)
+		Stats.sendLost++;
+		#endif
+		if (q->msg[pos].prio < prio)
+			return;		//the new message is the lowest
+		queueRemove(slot, pos);
+	}
+	TypeZ21SendMsg *m = &q->msg[q->count];
+	m->key = key;
+	m->prio = prio;
+	memcpy(m->data, data, len);
+	q->count++;
+}
+
+//--------------------------------------------------------------------------------------------
+//send while the client is ready, the oldest message with the highest priority first
+template <class Handler>
+void z21Base<Handler>::queueFlush(byte slot) {
+	TypeZ21SendQueue *q = &SendQueue[slot];
+	while (q->count > 0 && Handler::EthReady(ActIP[slot].client)) {
+		byte pos = 0;
+		for (byte i = 1; i < q->count && q->msg[pos].prio != z21PrioSafety; i++) {
+			if (q->msg[i].prio < q->msg[pos].prio)
+				pos = i;
+		}
+		Handler::EthSend(ActIP[slot].client, q->msg[pos].data);
+		queueRemove(slot, pos);
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+template <class Handler>
+void z21Base<Handler>::queueRemove(byte slot, byte pos) {
+	TypeZ21SendQueue *q = &SendQueue[slot];
+	q->count--;
+	for (byte i = pos; i < q->count; i++)
+		q->msg[i] = q->msg[i + 1];
+}
+
+//--------------------------------------------------------------------------------------------
+//Key of a state message: Header, X-Header, Adr - 0 for an event (CV result, LocoNet, ...)
+template <class Handler>
+uint32_t z21Base<Handler>::queueKey(byte *data) {
+	uint32_t key = (uint32_t)data[2] << 24;
+	switch (word(data[3], data[2])) {
+		case LAN_X_Header:
+			switch (data[4]) {	//X-Header
+				case LAN_X_LOCO_INFO:		//Adr
+				case LAN_X_TURNOUT_INFO:
+				case LAN_X_GET_EXT_ACCESSORY_INFO:
+					return key | ((uint32_t)data[4] << 16) | word(data[5] & 0x3F, data[6]);
+				case LAN_X_BC_TRACK_POWER:	//not LAN_X_UNKNOWN_COMMAND and LAN_X_CV_NACK
+					if (data[5] != 0x00 && data[5] != 0x01 && data[5] != 0x02 && data[5] != 0x08)
+						return 0;
+					//fall through
+				case LAN_X_STATUS_CHANGED:
+				case LAN_X_BC_STOPPED:
+					return key | ((uint32_t)LAN_X_BC_TRACK_POWER << 16);	//one state of the power
+			}
+			return 0;
+		case LAN_RMBUS_DATACHANGED:		//Gruppenindex
+			return key | data[4];
+		case LAN_RAILCOM_DATACHANGED:	//Adr
+			return key | word(data[5], data[4]);
+		case LAN_SYSTEMSTATE_DATACHANGED:
+			return key;
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------------------------------
+template <class Handler>
+byte z21Base<Handler>::queuePrio(byte *data) {
+	switch (word(data[3], data[2])) {
+		case LAN_X_Header:
+			switch (data[4]) {	//X-Header
+				case LAN_X_BC_TRACK_POWER:	//not LAN_X_UNKNOWN_COMMAND and LAN_X_CV_NACK
+					if (data[5] != 0x00 && data[5] != 0x01 && data[5] != 0x02 && data[5] != 0x08)
+						return z21PrioControl;
+					//fall through
+				case LAN_X_STATUS_CHANGED:
+				case LAN_X_BC_STOPPED:
+					return z21PrioSafety;
+			}
+			return z21PrioControl;
+		case LAN_RMBUS_DATACHANGED:
+		case LAN_RAILCOM_DATACHANGED:
+		case LAN_LOCONET_DETECTOR:
+		case LAN_CAN_DETECTOR:
+			return z21PrioFeedback;
+		case LAN_LOCONET_Z21_RX:
+		case LAN_LOCONET_Z21_TX:
+		case LAN_LOCONET_FROM_LAN:
+		case LAN_SYSTEMSTATE_DATACHANGED:
+		case LAN_DIAG_GETSTATS:
+			return z21PrioBulk;
+	}
+	return z21PrioControl;
+}
+#endif
+
+#if defined(Z21PERSIST)
+//--------------------------------------------------------------------------------------------
+//check the next blocks, store the first changed block (not more then one each z21PersistInterval)
+template <class Handler>
+void z21Base<Handler>::persistTick() {
+	byte data[z21PersistBlock];
+	for (byte n = 0; n < z21PersistScan; n++) {
+		persistBlock(PersistNext, data + 2);
+		uint16_t crc = persistCRC(PersistNext, data + 2);
+		if (crc != PersistCRC[PersistNext]) {
+			if (millis() - PersistTime < z21PersistInterval)
+				return;		//wait, check this block again
+			data[0] = crc & 0xFF;
+			data[1] = crc >> 8;
+			Handler::PersistWrite(PersistNext * z21PersistBlock, data, z21PersistBlock);
+			PersistCRC[PersistNext] = crc;
+			PersistTime = millis();
+			n = z21PersistScan;	//one block
+		}
+		PersistNext++;
+		if (PersistNext >= z21PersistBlocks)
+			PersistNext = 0;
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//Block: 0 = Header, 1... = client slot, then loco table and turnouts (Z21STATE)
+template <class Handler>
+void z21Base<Handler>::persistBlock(uint16_t block, byte *data) {
+	memset(data, 0, z21PersistData);
+	if (block == 0) {
+		data[0] = 'Z';
+		data[1] = 'S';
+		data[2] = z21PersistVersion;
+		data[3] = z21clientMAX;	//size of the tables
+		data[4] = z21PersistBlocks - 1 - z21clientMAX - z21PersistTrnt;
+		data[5] = z21PersistTrnt;
+		data[6] = Railpower;
+		return;
+	}
+	block--;
+	if (block < z21clientMAX) {
+		TypeActIP *ip = &ActIP[block];
+		if (ip->client == 0)
+			return;
+		data[0] = ip->client;
+		for (byte i = 0; i < 4; i++) {
+			data[1 + i] = ip->BCFlag >> (i * 8);
+			data[5 + i] = ip->ip >> (i * 8);
+		}
+		data[9] = ip->port & 0xFF;
+		data[10] = ip->port >> 8;
+		return;
+	}
+	#if defined(Z21STATE)
+	block -= z21clientMAX;
+	if (block < z21StateLocoMAX) {
+		uint16_t Adr;
+		if (State->getLocoSlot(block, Adr, data + 2)) {
+			data[0] = Adr & 0xFF;
+			data[1] = Adr >> 8;
+		}
+		return;
+	}
+	block -= z21StateLocoMAX;
+	for (byte i = 0; i < z21PersistData; i++)
+		data[i] = State->getTrntByte(block * z21PersistData + i);
+	#endif
+}
+
+//--------------------------------------------------------------------------------------------
+template <class Handler>
+void z21Base<Handler>::persistRestore(uint16_t block, byte *data) {
+	if (block == 0) {
+		#if defined(Z21PERSISTDCC)
+		Railpower = data[6];
+		#else
+		Railpower = csTrackVoltageOff;	//nobody at the throttle after a reset, the user switch the track on
+		#endif
+		#if defined(Z21STATE)
+		State->setPower(Railpower);
+		#endif
+		addEvent(z21EventRailPower, 0, Railpower);	//DCC side up with the restored power
+		return;
+	}
+	block--;
+	if (block < z21clientMAX) {
+		if (data[0] == 0)
+			return;
+		TypeActIP *ip = &ActIP[block];
+		ip->client = data[0];
+		ip->BCFlag = 0;
+		ip->ip = 0;
+		for (byte i = 0; i < 4; i++) {
+			ip->BCFlag |= (unsigned long) data[1 + i] << (i * 8);
+			ip->ip |= (uint32_t) data[5 + i] << (i * 8);
+		}
+		ip->port = word(data[10], data[9]);
+		ip->time = z21ActTimeIP;	//removed if the client don't come back
+		return;
+	}
+	#if defined(Z21STATE)
+	block -= z21clientMAX;
+	if (block < z21StateLocoMAX) {
+		uint16_t Adr = word(data[1], data[0]);
+		if (Adr == 0)
+			return;
+		#if !defined(Z21PERSISTDCC)
+		data[3] &= 0x80;	//stopped, keep the direction
+		#endif
+		State->setLoco(Adr, data + 2);
+		#if defined(Z21PERSISTDCC)
+		byte steps = 128;	//DCC like before the restart, F29 - F31 are not stored
+		if ((data[2] & 0x03) == DCCSTEP14)
+			steps = 14;
+		else if ((data[2] & 0x03) == DCCSTEP28)
+			steps = 28;
+		addEvent(z21EventLocoSpeed, Adr, data[3], steps);
+		addEvent(z21EventLocoFktGroup, Adr, 0x20, data[4] & 0x1F);	//F0 - F4
+		if (data[5] & 0x0F)
+			addEvent(z21EventLocoFktGroup, Adr, 0x21, data[5] & 0x0F);	//F5 - F8
+		if (data[5] >> 4)
+			addEvent(z21EventLocoFktGroup, Adr, 0x22, data[5] >> 4);	//F9 - F12
+		if (data[6])
+			addEvent(z21EventLocoFktGroup, Adr, 0x23, data[6]);	//F13 - F20
+		if (data[7])
+			addEvent(z21EventLocoFktGroup, Adr, 0x28, data[7]);	//F21 - F28
+		#endif
+		return;
+	}
+	block -= z21StateLocoMAX;
+	for (byte i = 0; i < z21PersistData; i++)
+		State->setTrntByte(block * z21PersistData + i, data[i]);
+	#endif
+}
+
+//--------------------------------------------------------------------------------------------
+//CRC-16 CCITT of the block number and the data, a block at the wrong place is not valid
+template <class Handler>
+uint16_t z21Base<Handler>::persistCRC(uint16_t block, byte *data) {
+	uint16_t crc = 0xFFFF;
+	for (byte i = 0; i < z21PersistData + 2; i++) {
+		byte b = (i == 0) ? (block & 0xFF) : (i == 1) ? (block >> 8) : data[i - 2];
+		crc ^= (uint16_t) b << 8;
+		for (byte k = 0; k < 8; k++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+#endif
+
+#if defined(Z21ACCQUEUE)
+//--------------------------------------------------------------------------------------------
+//add the turnout command, a waiting command to the same Adr get the new state
+template <class Handler>
+void z21Base<Handler>::accQueue(uint16_t Adr, byte state) {
+	for (byte i = 0; i < AccCount; i++) {
+		if (AccQueue[i].adr == Adr) {	//not started yet
+			AccQueue[i].state = state;
+			#if defined(Z21STATS)
+			Stats.accCollapsed++;
+			#endif
+			return;
+		}
+	}
+	for (byte i = 0; i < AccActiveCount; i++) {
+		if (AccActive[i].adr == Adr && AccActive[i].state == state) {	//coil is already on
+			#if defined(Z21STATS)
+			Stats.accCollapsed++;
+			#endif
+			return;
+		}
+	}
+	if (AccCount == z21AccQueueMAX) {
+		#if defined(Z21STATS)
+		Stats.accLost++;
+		#endif
+		return;
+	}
+	if (!AccRoute) {	//first command of a route
+		AccRoute = true;
+		AccStart = millis();
+	}
+	AccQueue[AccCount].adr = Adr;
+	AccQueue[AccCount].state = state;
+	AccCount++;
+	accRun();	//start now if a coil is free
+}
+
+//--------------------------------------------------------------------------------------------
+//switch the coils off after the pulse and start the oldest waiting commands
+template <class Handler>
+void z21Base<Handler>::accRun() {
+	unsigned long now = millis();
+	for (byte i = 0; i < AccActiveCount; ) {
+		if (now - AccActive[i].time >= AccPulse && addEvent(z21EventAccessory, AccActive[i].adr, AccActive[i].state, false)) {	//coil off, queue full: next tick()
+			AccActiveCount--;
+			AccActive[i] = AccActive[AccActiveCount];
+		}
+		else i++;
+	}
+	for (byte i = 0; i < AccCount && AccActiveCount < AccActiveLimit; ) {
+		bool busy = false;	//other output of the same Adr is on
+		for (byte a = 0; a < AccActiveCount; a++)
+			busy |= AccActive[a].adr == AccQueue[i].adr;
+		if (busy) {
+			i++;
+			continue;
+		}
+		if (!addEvent(z21EventAccessory, AccQueue[i].adr, AccQueue[i].state, true))	//coil on
+			break;	//queue full, start with the next tick()
+		AccActive[AccActiveCount] = AccQueue[i];
+		AccActive[AccActiveCount].time = now;
+		AccActiveCount++;
+		AccCount--;
+		for (byte p = i; p < AccCount; p++)
+			AccQueue[p] = AccQueue[p + 1];
+	}
+	if (AccCount == 0 && AccActiveCount == 0) {	//route is done
+		AccRoute = false;
+		AccSettle = now - AccStart;
+		#if defined(Z21STATS)
+		Stats.accSettle = AccSettle;
+		#endif
+	}
+}
+#endif
+
+#if defined(Z21TRACE)
+//--------------------------------------------------------------------------------------------
+//add the message to the trace ring, no lock: a slow reader lose the oldest records
+template <class Handler>
+void z21Base<Handler>::traceAdd(byte client, byte dir, byte *data) {
+	unsigned int pos = z21AtomicFetchAdd(TraceHead, 1);
+	TypeZ21Trace *t = &Trace[pos & (z21TraceMAX - 1)];
+	z21AtomicStore(t->seq, (pos << 1) + 1);	//writing
+	z21AtomicFence();
+	t->time = micros();
+	t->client = client;
+	t->dir = dir;
+	t->len = word(data[1], data[0]);
+	t->header = word(data[3], data[2]);
+	for (byte i = 0; i < z21TraceData && i + 4 < t->len; i++)
+		t->data[i] = data[i + 4];
+	z21AtomicStore(t->seq, (pos << 1) + 2);	//done
+}
+#endif
+
+//--------------------------------------------------------------------------------------------
+//collect all following messages to the client in one datagram
+template <class Handler>
+void z21Base<Handler>::EthBufferBegin (byte client) {
+	EthBufferFlush();
+	#if defined(Z21SENDQUEUE)
+	if (Handler::hasEthReady())
+		return;	//each message through the queue of the client, only send if EthReady() and after the queued ones
+	#endif
+	TXBufferClient = client;
+}
+
+//--------------------------------------------------------------------------------------------
+//send the collected messages
+template <class Handler>
+void z21Base<Handler>::EthBufferFlush () {
+	if (TXBufferLen == 0)
+		return;
+	if (Handler::hasEthSendDatagram())
+		Handler::EthSendDatagram(TXBufferClient, TXBuffer, TXBufferLen);
+	else {	//each message alone
+		for (uint16_t i = 0; i < TXBufferLen; i += word(TXBuffer[i+1], TXBuffer[i]))
+			Handler::EthSend(TXBufferClient, &TXBuffer[i]);
+	}
+	#if defined(Z21STATS)
+	Stats.txDatagrams[z21StatDirect]++;
+	Stats.txBytes[z21StatDirect] += TXBufferLen;
+	#endif
+	TXBufferLen = 0;
+}
+
+//--------------------------------------------------------------------------------------------
+//send the collected messages and stop collecting
+template <class Handler>
+void z21Base<Handler>::EthBufferEnd () {
+	EthBufferFlush();
+	TXBufferClient = 0;
+}
+
+//--------------------------------------------------------------------------------------------
+//turnout state to all clients
+template <class Handler>
+void z21Base<Handler>::returnTrntInfo (uint16_t Adr, bool State) {
+	byte data[4];
+	data[0] = LAN_X_TURNOUT_INFO;  //0x43 X-HEADER
+	data[1] = Adr >> 8;   //High
+	data[2] = Adr & 0xFF; //Low
+	data[3] = State + 1;
+	//  if (State == true)
+	//    data[3] = 2;
+	//  else data[3] = 1;  
+	EthSend(0, 0x09, LAN_X_Header, data, true, Z21bcAll);
+}
+
+//--------------------------------------------------------------------------------------------
+//power state to the client or (client = 0) to all
+template <class Handler>
+void z21Base<Handler>::returnPower (byte client) {
+	byte data[] = { LAN_X_BC_TRACK_POWER, 0x00  };
+	switch (Railpower) {
+		case csNormal: 
+				data[1] = 0x01;
+				break;
+		case csTrackVoltageOff: 
+				data[1] = 0x00;
+				break;
+		case csServiceMode: 
+				data[1] = 0x02;
+				break;
+		case csShortCircuit: 
+				data[1] = 0x08;
+				break;
+		case csEmergencyStop:
+				data[0] = 0x81;
+				data[1] = 0x00;    
+				break;
+	}
+	if (client > 0)
+		EthSend(client, 0x07, LAN_X_Header, data, true, Z21bcNone);
+	else EthSend(0, 0x07, LAN_X_Header, data, true, Z21bcAll);
+}
+
+#if !defined(Z21NOLOCONET)
+//--------------------------------------------------------------------------------------------
+//LocoNet tunnel only to the clients that request the class of the opcode (data[0])
+template <class Handler>
+void z21Base<Handler>::EthSendLN (byte client, byte DataLen, unsigned int Header, byte *dataString) {
+	EthSend(client, DataLen, Header, dataString, false, LNclassBcFlag[getLNClass(dataString[0])]);
+}
+#endif
+
+//--------------------------------------------------------------------------------------------
+//Convert EEPROM stored flag back into a Z21 Flag
+template <class Handler>
+unsigned long z21Base<Handler>::getz21BcFlag (uint16_t flag) {
+  unsigned long outFlag = 0;
+  if ((flag & Z21bcAll_e) != 0)
+    outFlag |= Z21bcAll;
+  if ((flag & Z21bcRBus_e) != 0)
+    outFlag |= Z21bcRBus;
+  #if !defined(Z21NORAILCOM)
+  if ((flag & Z21bcRailcom_e) != 0)
+    outFlag |= Z21bcRailcom;
+  #endif
+  if ((flag & Z21bcSystemInfo_e) != 0)
+    outFlag |= Z21bcSystemInfo;
+  if ((flag & Z21bcNetAll_e) != 0)
+    outFlag |= Z21bcNetAll;
+  #if !defined(Z21NOLOCONET)
+  if ((flag & Z21bcLocoNet_e) != 0)
+    outFlag |= Z21bcLocoNet;
+  if ((flag & Z21bcLocoNetLocos_e) != 0)
+    outFlag |= Z21bcLocoNetLocos;
+  if ((flag & Z21bcLocoNetSwitches_e) != 0)
+    outFlag |= Z21bcLocoNetSwitches;
+  if ((flag & Z21bcLocoNetGBM_e) != 0)    
+    outFlag |= Z21bcLocoNetGBM;
+  #endif
+  #if !defined(Z21NORAILCOM)
+  if ((flag & Z21bcRailComAll_e) != 0)
+    outFlag |= Z21bcRailComAll;
+  #endif
+  #if !defined(Z21NOCAN)
+  if ((flag & Z21bcCANDetector_e) != 0)
+    outFlag |= Z21bcCANDetector;
+  #endif
+  return outFlag;
+}
+
+//--------------------------------------------------------------------------------------------
+//Convert Z21 LAN BC flag to EEPROM stored flag
+template <class Handler>
+uint16_t z21Base<Handler>::getLocalBcFlag (unsigned long flag) {
+  uint16_t outFlag = 0;
+  if ((flag & Z21bcAll) != 0)
+    outFlag |= Z21bcAll_e;
+  if ((flag & Z21bcRBus) != 0) 
+    outFlag |= Z21bcRBus_e;
+  #if !defined(Z21NORAILCOM)
+  if ((flag & Z21bcRailcom) != 0) 
+    outFlag |= Z21bcRailcom_e;
+  #endif
+  if ((flag & Z21bcSystemInfo) != 0)
+    outFlag |= Z21bcSystemInfo_e;
+  if ((flag & Z21bcNetAll) != 0)
+    outFlag |= Z21bcNetAll_e;
+  #if !defined(Z21NOLOCONET)
+  if ((flag & Z21bcLocoNet) != 0)
+    outFlag |= Z21bcLocoNet_e;
+  if ((flag & Z21bcLocoNetLocos) != 0)
+    outFlag |= Z21bcLocoNetLocos_e;
+  if ((flag & Z21bcLocoNetSwitches) != 0)
+    outFlag |= Z21bcLocoNetSwitches_e;
+  if ((flag & Z21bcLocoNetGBM) != 0) 
+    outFlag |= Z21bcLocoNetGBM_e;
+  #endif
+  #if !defined(Z21NORAILCOM)
+  if ((flag & Z21bcRailComAll) != 0) 
+    outFlag |= Z21bcRailComAll_e;
+  #endif
+  #if !defined(Z21NOCAN)
+  if ((flag & Z21bcCANDetector) != 0) 
+    outFlag |= Z21bcCANDetector_e;
+  #endif
+  return outFlag;  
+}
+
+//--------------------------------------------------------------------------------------------
+// delete the stored IP-Address
+template <class Handler>
+void z21Base<Handler>::clearIP (byte pos) {
+			ActIP[pos].client = 0;
+			ActIP[pos].BCFlag = 0;
+			ActIP[pos].time = 0;
+			ActIP[pos].adr = 0;
+			if (ActIP[pos].port != 0) {	//remove the endpoint
+				ActIP[pos].port = 0;
+				endpointRebuild();
+			}
+			#if defined(Z21SENDQUEUE)
+			SendQueue[pos].count = 0;
+			#endif
+}
+
+//--------------------------------------------------------------------------------------------
+template <class Handler>
+void z21Base<Handler>::clearIPSlots() {
+  for (int i = 0; i < z21clientMAX; i++) 
+    clearIP(i);
+}
+
+//--------------------------------------------------------------------------------------------
+template <class Handler>
+void z21Base<Handler>::clearIPSlot(byte client) {
+  for (int i = 0; i < z21clientMAX; i++) {
+	  if (ActIP[i].client == client) {
+		  clearIP(i);
+		  return;
+	  }
+  }
+}
+
+//--------------------------------------------------------------------------------------------
+//speichern des BCFlag im EEPROM
+template <class Handler>
+void z21Base<Handler>::setEEPROMBCFlag(byte IPHash, unsigned long BCFlag) {
+	uint16_t flag = getLocalBcFlag(BCFlag);
+	FSTORAGE.FSTORAGEMODE(CLIENTHASHSTORE | IPHash, flag & 0xFF);
+	FSTORAGE.FSTORAGEMODE(CLIENTHASHSTOREHIGH | IPHash, flag >> 8);
+	#if defined(SERIALDEBUG)
+	ZDebug.print(CLIENTHASHSTORE | IPHash);
+	ZDebug.print(" write: ");
+	ZDebug.println(flag, BIN);
+	#endif
+}
+
+//--------------------------------------------------------------------------------------------
+//lesen des BCFlag im EEPROM
+template <class Handler>
+unsigned long z21Base<Handler>::findEEPROMBCFlag(byte IPHash) {
+	uint8_t flag = FSTORAGE.read(CLIENTHASHSTORE | IPHash);
+	uint8_t flagHigh = FSTORAGE.read(CLIENTHASHSTOREHIGH | IPHash);
+	#if defined(SERIALDEBUG)
+	ZDebug.print(CLIENTHASHSTORE | IPHash);
+	ZDebug.print("read: ");
+	ZDebug.print(flagHigh, BIN);
+	ZDebug.print("-");
+	ZDebug.println(flag, BIN);
+	#endif
+	//wurde BC im EEPROM bereits erfasst?
+	if (flag == 0xFF)
+		return 0x00;	//not found!
+	if (flagHigh == 0xFF)
+		flagHigh = 0x00;	//only Low Byte stored (old version)
+	return getz21BcFlag(word(flagHigh, flag));
+}
+
+//--------------------------------------------------------------------------------------------
+template <class Handler>
+unsigned long z21Base<Handler>::addIPToSlot (byte client, unsigned long BCFlag) {
+  byte Slot = z21clientMAX;
+  
+  for (byte i = 0; i < z21clientMAX; i++) {
+    if (ActIP[i].client == client) {
+      ActIP[i].time = z21ActTimeIP;
+      if (BCFlag != 0) {   //Falls BC Flag übertragen wurde diesen hinzufügen!
+        ActIP[i].BCFlag = BCFlag;
+		if (Handler::hasClientHash())
+			setEEPROMBCFlag(Handler::ClientHash(client), BCFlag);
+	  }
+      return ActIP[i].BCFlag;    //BC Flag 4. Byte Rückmelden
+    }
+    else if (ActIP[i].time == 0 && Slot == z21clientMAX)
+      Slot = i;
+  }
+  if (Slot == z21clientMAX)
+	return BCFlag;	//kein Speicherplatz frei!
+  addNewIPSlot(Slot, client);
+  return ActIP[Slot].BCFlag;   //BC Flag 4. Byte Rückmelden
+}
+
+//--------------------------------------------------------------------------------------------
+//new client inside a free slot
+template <class Handler>
+void z21Base<Handler>::addNewIPSlot (byte Slot, byte client) {
+  ActIP[Slot].client = client;
+  ActIP[Slot].time = z21ActTimeIP;
+
+  //read out last BCFlag from EEPROM:
+  if (Handler::hasClientHash())
+	ActIP[Slot].BCFlag = findEEPROMBCFlag(Handler::ClientHash(client));
+
+  sendClientSnapshot(client, ActIP[Slot].BCFlag);		//inform only the new client with last state
+}
+
+//--------------------------------------------------------------------------------------------
+//client of the endpoint, a new endpoint get a free slot and the client Slot + 1
+template <class Handler>
+uint8_t z21Base<Handler>::getClient (uint32_t ip, uint16_t port) {
+  uint16_t h = endpointHash(ip, port);
+  while (EndpointHash[h] != 0) {
+	byte Slot = EndpointHash[h] - 1;
+	if (ActIP[Slot].ip == ip && ActIP[Slot].port == port)
+		return ActIP[Slot].client;
+	h = (h + 1) & (z21EndpointHashMAX - 1);
+  }
+  for (byte i = 0; i < z21clientMAX; i++) {
+	if (ActIP[i].time == 0) {
+		clearIP(i);		//remove the old endpoint
+		h = endpointHash(ip, port);
+		while (EndpointHash[h] != 0)
+			h = (h + 1) & (z21EndpointHashMAX - 1);
+		EndpointHash[h] = i + 1;
+		ActIP[i].ip = ip;
+		ActIP[i].port = port;
+		addNewIPSlot(i, i + 1);
+		return i + 1;
+	}
+  }
+  return 0;	//kein Speicherplatz frei!
+}
+
+//--------------------------------------------------------------------------------------------
+//endpoint of the client for the send functions
+template <class Handler>
+bool z21Base<Handler>::getEndpoint (uint8_t client, uint32_t &ip, uint16_t &port) {
+  if (client == 0 || client > z21clientMAX)
+	return false;
+  TypeActIP *act = &ActIP[client - 1];
+  if (act->client != client || act->port == 0)
+	return false;
+  ip = act->ip;
+  port = act->port;
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------
+//first place inside the open addressing table
+template <class Handler>
+uint16_t z21Base<Handler>::endpointHash (uint32_t ip, uint16_t port) {
+  uint32_t h = (ip ^ ((uint32_t)port << 16) ^ port) * 2654435761UL;
+  return (h >> 16) & (z21EndpointHashMAX - 1);
+}
+
+//--------------------------------------------------------------------------------------------
+//fill the table again with all endpoints, after a client is deleted
+template <class Handler>
+void z21Base<Handler>::endpointRebuild () {
+  memset(EndpointHash, 0, sizeof(EndpointHash));
+  for (byte i = 0; i < z21clientMAX; i++) {
+	if (ActIP[i].port != 0) {
+		uint16_t h = endpointHash(ActIP[i].ip, ActIP[i].port);
+		while (EndpointHash[h] != 0)
+			h = (h + 1) & (z21EndpointHashMAX - 1);
+		EndpointHash[h] = i + 1;
+	}
+  }
+}
+
+//--------------------------------------------------------------------------------------------
+//Snapshot for a new client: power state, BC-Flag and turnouts collected in one datagram
+template <class Handler>
+void z21Base<Handler>::sendClientSnapshot (byte client, unsigned long BCFlag) {
+	byte data[4];
+	EthBufferBegin(client);
+	returnPower(client);
+	data[0] = BCFlag;
+	data[1] = BCFlag >> 8;
+	data[2] = BCFlag >> 16;
+	data[3] = BCFlag >> 24;
+	EthSend (client, 0x08, LAN_GET_BROADCASTFLAGS, data, false, Z21bcNone); 
+	#if (z21SnapshotTrnt > 0)
+	if (Handler::hasAccessoryInfo()) {
+		for (uint16_t Adr = 0; Adr < z21SnapshotTrnt; Adr++) {
+			data[0] = LAN_X_TURNOUT_INFO;  //0x43 X-HEADER
+			data[1] = Adr >> 8;   //High
+			data[2] = Adr & 0xFF; //Low
+			if (Handler::AccessoryInfo(Adr) == true)
+				data[3] = 0x02;  //active
+			else data[3] = 0x01;  //inactive
+			EthSend (client, 0x09, LAN_X_Header, data, true, Z21bcNone);
+		}
+	}
+	#endif
+	EthBufferEnd();
+}
+
+//--------------------------------------------------------------------------------------------
+//check if there are slots with the same loco, set them to busy
+template <class Handler>
+void z21Base<Handler>::setOtherSlotBusy(byte slot) {
+	for (byte i = 0; i < z21clientMAX; i++) {
+		if ((i != slot) && (ActIP[slot].adr == ActIP[i].adr)) { //if in other Slot -> set busy
+			ActIP[i].adr = 0; //clean slot that informed as busy & let it activ
+			//Inform with busy message:
+			//not used!
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//Add loco to slot. 
+template <class Handler>
+void z21Base<Handler>::addBusySlot (byte client, uint16_t adr) {
+	for (byte i = 0; i < z21clientMAX; i++) {
+		if (ActIP[i].client == client) {
+			if (ActIP[i].adr != adr) {	//skip is already used by this client
+				ActIP[i].adr = adr;		//store loco that is used
+				setOtherSlotBusy(i);	//make other busy
+			}
+			break;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//used by non Z21 client
+template <class Handler>
+void z21Base<Handler>::reqLocoBusy (uint16_t adr) {
+	for (byte i = 0; i < z21clientMAX; i++) {
+		if (adr == ActIP[i].adr) {
+			ActIP[i].adr = 0;	//clear
+		}
+	}
+}
+
+#endif
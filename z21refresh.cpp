@@ -0,0 +1,279 @@
+/*
+*****************************************************************************
+  *		z21refresh.cpp - refresh of the locos on the track (DCC scheduler)
+  *		Copyright (c) 2026 Philipp Gahtow  All right reserved.
+  *
+  *
+*****************************************************************************
+  * IMPORTANT:
+  *
+  * 	Please contact ROCO Inc. for more details.
+*****************************************************************************
+*/
+
+// include this library's description file
+#include <z21refresh.h>
+
+//function group n -> DB0 of LAN_X_SET_LOCO_FUNCTION_GROUP
+static const byte Group[z21RefreshGroupMAX] = {0x20, 0x21, 0x22, 0x23, 0x28, 0x29, 0x2A, 0x2B, 0x50, 0x51};
+
+static byte groupIndex(byte group) {
+	for (byte i = 0; i < z21RefreshGroupMAX; i++) {
+		if (Group[i] == group)
+			return i;
+	}
+	return z21RefreshGroupMAX;
+}
+
+// Constructor /////////////////////////////////////////////////////////////////
+// Function that handles the creation and setup of instances
+
+z21RefreshClass::z21RefreshClass()
+{
+	clear();
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+// Functions available in Wiring sketches, this library, and other libraries
+
+//--------------------------------------------------------------------------------------------
+//speed and direction (RVVV VVVV) of the loco
+void z21RefreshClass::setSpeed(uint16_t Adr, byte speed, byte steps) {
+	byte slot = addLoco(Adr);
+	if (slot == z21RefreshMAX)
+		return;
+	Loco[slot].used = millis();
+	if (Loco[slot].speed == speed && Loco[slot].steps == steps)
+		return;	//no change
+	Loco[slot].speed = speed;
+	Loco[slot].steps = steps;
+	setPending(slot, 0x01);
+}
+
+//--------------------------------------------------------------------------------------------
+//single function F0 - F68 of the loco
+void z21RefreshClass::setFkt(uint16_t Adr, byte type, byte fkt) {
+	byte n = groupIndex(z21DCCFktGroup(fkt));
+	if (n == z21RefreshGroupMAX)
+		return;	//unknown function
+	byte slot = addLoco(Adr);
+	if (slot == z21RefreshMAX)
+		return;
+	byte bit;	//Bit inside the group
+	if (fkt == 0)
+		bit = 0x10;
+	else if (fkt <= 12)
+		bit = 1 << ((fkt - 1) & 0x03);
+	else bit = 1 << ((fkt - 13) & 0x07);
+	byte value = Loco[slot].fkt[n];
+	if (type == 0)
+		value &= ~bit;
+	else if (type == 1)
+		value |= bit;
+	else value ^= bit;
+	Loco[slot].used = millis();
+	if (value == Loco[slot].fkt[n])
+		return;
+	Loco[slot].fkt[n] = value;
+	setPending(slot, (1 << (n + 1)) | (n == 0 && Loco[slot].steps == 14));	//14 steps: the speed carry F0
+}
+
+//--------------------------------------------------------------------------------------------
+//function group of the loco
+void z21RefreshClass::setFktGroup(uint16_t Adr, byte group, byte fkt) {
+	byte n = groupIndex(group);
+	if (n == z21RefreshGroupMAX)
+		return;
+	byte slot = addLoco(Adr);
+	if (slot == z21RefreshMAX)
+		return;
+	if (n < 3)
+		fkt &= n == 0 ? 0x1F : 0x0F;
+	Loco[slot].used = millis();
+	if (fkt == Loco[slot].fkt[n])
+		return;
+	Loco[slot].fkt[n] = fkt;
+	setPending(slot, (1 << (n + 1)) | (n == 0 && Loco[slot].steps == 14));	//14 steps: the speed carry F0
+}
+
+//--------------------------------------------------------------------------------------------
+void z21RefreshClass::remove(uint16_t Adr) {
+	byte slot = findLoco(Adr);
+	if (slot != z21RefreshMAX)
+		removeSlot(slot);
+}
+
+//--------------------------------------------------------------------------------------------
+void z21RefreshClass::clear() {
+	memset(Loco, 0, sizeof(Loco));
+	ChangedFirst = 0;
+	ChangedCount = 0;
+	Cursor = 0;
+	Urgent = 0;
+}
+
+//--------------------------------------------------------------------------------------------
+//next DCC packet for the track
+byte z21RefreshClass::next(byte *packet) {
+	if (ChangedCount > 0 && Urgent < z21RefreshUrgentMAX) {
+		Urgent++;
+		byte len = sendChanged(packet);
+		if (len > 0)
+			return len;
+	}
+	Urgent = 0;
+	byte len = sendRefresh(packet);
+	if (len == 0)	//nothing to refresh this round
+		len = sendChanged(packet);
+	return len;
+}
+
+//--------------------------------------------------------------------------------------------
+byte z21RefreshClass::count() {
+	byte n = 0;
+	for (byte i = 0; i < z21RefreshMAX; i++) {
+		if (Loco[i].adr != 0)
+			n++;
+	}
+	return n;
+}
+
+// Private Methods ///////////////////////////////////////////////////////////////////////////////////////////////////
+// Functions only available to other functions in this library *******************************************************
+
+//--------------------------------------------------------------------------------------------
+byte z21RefreshClass::findLoco(uint16_t Adr) {
+	for (byte i = 0; i < z21RefreshMAX; i++) {
+		if (Loco[i].adr == Adr)
+			return i;
+	}
+	return z21RefreshMAX;
+}
+
+//--------------------------------------------------------------------------------------------
+//find or add the loco, if full replace the stopped loco with the oldest command (else the oldest loco)
+byte z21RefreshClass::addLoco(uint16_t Adr) {
+	if (Adr == 0 || Adr > 10239)
+		return z21RefreshMAX;	//no loco
+	byte slot = findLoco(Adr);
+	if (slot != z21RefreshMAX)
+		return slot;
+	slot = findLoco(0);	//free slot
+	if (slot == z21RefreshMAX) {
+		unsigned long now = millis();
+		unsigned long oldest = 0;
+		bool stopped = false;
+		for (byte i = 0; i < z21RefreshMAX; i++) {
+			bool s = z21DCCSpeedStep(Loco[i].speed, Loco[i].steps) == 0;
+			if ((s && !stopped) || (s == stopped && now - Loco[i].used >= oldest)) {
+				oldest = now - Loco[i].used;
+				stopped = s;
+				slot = i;
+			}
+		}
+		removeSlot(slot);
+	}
+	Loco[slot].adr = Adr;
+	Loco[slot].steps = 128;
+	Loco[slot].used = millis();
+	return slot;
+}
+
+//--------------------------------------------------------------------------------------------
+void z21RefreshClass::removeSlot(byte slot) {
+	if (Loco[slot].pending != 0) {	//remove from the ring
+		byte n = 0;
+		for (byte i = 0; i < ChangedCount; i++) {
+			byte s = Changed[(ChangedFirst + i) % z21RefreshMAX];
+			if (s != slot)
+				Changed[(ChangedFirst + n++) % z21RefreshMAX] = s;
+		}
+		ChangedCount = n;
+	}
+	memset(&Loco[slot], 0, sizeof(TypeZ21RefreshLoco));
+}
+
+//--------------------------------------------------------------------------------------------
+void z21RefreshClass::setPending(byte slot, uint16_t bits) {
+	if (Loco[slot].pending == 0) {	//add to the end of the ring
+		Changed[(ChangedFirst + ChangedCount) % z21RefreshMAX] = slot;
+		ChangedCount++;
+	}
+	Loco[slot].pending |= bits;
+	Loco[slot].level = 0;	//refresh again each round
+	Loco[slot].skip = 0;
+}
+
+//--------------------------------------------------------------------------------------------
+//oldest change
+byte z21RefreshClass::sendChanged(byte *packet) {
+	while (ChangedCount > 0) {
+		byte slot = Changed[ChangedFirst];
+		byte part = 0;
+		while (part <= z21RefreshGroupMAX && bitRead(Loco[slot].pending, part) == 0)
+			part++;
+		bitClear(Loco[slot].pending, part);
+		if (Loco[slot].pending == 0) {
+			ChangedFirst = (ChangedFirst + 1) % z21RefreshMAX;
+			ChangedCount--;
+		}
+		byte len = encode(packet, slot, part);
+		if (len > 0)
+			return len;
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------------------------------
+//next loco of the refresh
+byte z21RefreshClass::sendRefresh(byte *packet) {
+	for (byte n = 0; n < z21RefreshMAX; n++) {
+		byte slot = Cursor;
+		Cursor = (Cursor + 1) % z21RefreshMAX;
+		TypeZ21RefreshLoco *loco = &Loco[slot];
+		if (loco->adr == 0)
+			continue;
+		if (loco->skip > 0) {
+			loco->skip--;
+			continue;
+		}
+		bool stopped = z21DCCSpeedStep(loco->speed, loco->steps) == 0;
+		if (stopped && millis() - loco->used > z21RefreshPurge) {
+			removeSlot(slot);
+			continue;
+		}
+		byte part = loco->part;
+		//next packet: speed, F0-F12, higher groups only with a function on
+		do {
+			loco->part++;
+		} while (loco->part > 3 && loco->part <= z21RefreshGroupMAX && loco->fkt[loco->part - 1] == 0);
+		if (loco->part > z21RefreshGroupMAX) {	//all packets sent
+			loco->part = 0;
+			bool idle = stopped;
+			for (byte i = 0; i < z21RefreshGroupMAX && idle; i++)
+				idle = loco->fkt[i] == 0;
+			if (!idle)
+				loco->level = 0;
+			else if (loco->level < z21RefreshLevelMAX)
+				loco->level++;
+		}
+		loco->skip = (1 << loco->level) - 1;
+		byte len = encode(packet, slot, part);
+		if (len > 0)
+			return len;
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------------------------------
+//part 0 = speed, 1 + n = function group n
+byte z21RefreshClass::encode(byte *packet, byte slot, byte part) {
+	if (part == 0) {
+		if (Loco[slot].steps == 14)	//F0 (FL) is bit 4 of the speed
+			return z21DCCLocoSpeed(packet, Loco[slot].adr, (Loco[slot].speed & ~0x10) | (Loco[slot].fkt[0] & 0x10), 14);
+		return z21DCCLocoSpeed(packet, Loco[slot].adr, Loco[slot].speed, Loco[slot].steps);
+	}
+	if (part > z21RefreshGroupMAX)
+		return 0;
+	return z21DCCLocoFktGroup(packet, Loco[slot].adr, Group[part - 1], Loco[slot].fkt[part - 1]);
+}
@@ -0,0 +1,92 @@
+/*
+  z21refresh.h - refresh of the locos on the track (DCC scheduler)
+  Copyright (c) 2026 Philipp Gahtow  All right reserved.
+
+  Notice:
+	- feed the loco commands from notifyz21LocoSpeed, notifyz21LocoFkt... into the scheduler,
+	  next() return the next DCC packet (z21dcc.h) for the track
+	- a changed speed or function group is sent first (in order of the change),
+	  after z21RefreshUrgentMAX changed packets one refresh packet follow
+	- the refresh visit one loco after the other, each visit send one packet
+	  (speed, F0-F4, F5-F8, F9-F12, higher groups only if a function is on),
+	  with 14 speed steps the speed packet carry F0 (FL) too
+	- a stopped loco without functions is refreshed less often each round (up to 1 of 2^z21RefreshLevelMAX)
+	- a stopped loco without command for z21RefreshPurge ms is removed,
+	  if the table is full the loco with the oldest command is replaced
+*/
+
+#ifndef z21refresh_h
+#define z21refresh_h
+
+// include types & constants of Wiring core API
+#if defined(WIRING)
+ #include <Wiring.h>
+#elif ARDUINO >= 100
+ #include <Arduino.h>
+#else
+ #include <WProgram.h>
+#endif
+
+#include "z21dcc.h"
+
+//--------------------------------------------------------------
+#if !defined(z21RefreshMAX)
+#if defined(__AVR__)
+#define z21RefreshMAX 8			//Anzahl Loks im Refresh
+#else
+#define z21RefreshMAX 64		//Anzahl Loks im Refresh (max. 255)
+#endif
+#endif
+
+#define z21RefreshGroupMAX 10		//function groups F0 - F68
+#define z21RefreshUrgentMAX 3		//changed packets before the next refresh packet
+#define z21RefreshLevelMAX 5		//stopped loco: refresh 1 of 32 rounds
+#define z21RefreshPurge 300000UL	//ms without command, remove a stopped loco
+
+struct TypeZ21RefreshLoco {
+  uint16_t adr;		//0 = unused
+  byte speed;		//R + speed like notifyz21LocoSpeed
+  byte steps;		//14, 28 or 128
+  byte fkt[z21RefreshGroupMAX];	//value of each function group (DB1 of LAN_X_SET_LOCO_FUNCTION_GROUP)
+  uint16_t pending;	//changed: Bit 0 = speed, Bit 1 + n = function group n
+  byte part;		//next packet of the refresh: 0 = speed, 1 + n = function group n
+  byte level;		//refresh 1 of 2^level rounds
+  byte skip;		//rounds until the next refresh
+  unsigned long used;	//millis() of the last command
+};
+
+// library interface description
+class z21RefreshClass
+{
+  // user-accessible "public" interface
+  public:
+	z21RefreshClass(void);	//Constuctor
+
+	void setSpeed(uint16_t Adr, byte speed, byte steps);	//like notifyz21LocoSpeed
+	void setFkt(uint16_t Adr, byte type, byte fkt);		//like notifyz21LocoFkt: type 0 = off, 1 = on, 2 = toggle; fkt: F0 - F68
+	void setFktGroup(uint16_t Adr, byte group, byte fkt);	//group: DB0 of LAN_X_SET_LOCO_FUNCTION_GROUP
+	void remove(uint16_t Adr);		//loco no longer on the track
+	void clear();
+
+	byte next(byte *packet);	//next DCC packet (z21DCCPacketMAX), return length, 0 = nothing to send (idle packet)
+	byte count();			//locos inside the refresh
+
+  // library-accessible "private" interface
+  private:
+	TypeZ21RefreshLoco Loco[z21RefreshMAX];
+	byte Changed[z21RefreshMAX];	//ring of the locos with pending changes, oldest first
+	byte ChangedFirst;
+	byte ChangedCount;
+	byte Cursor;		//next loco of the refresh
+	byte Urgent;		//changed packets in a row
+
+	byte findLoco(uint16_t Adr);	//slot of the loco, z21RefreshMAX if unknown
+	byte addLoco(uint16_t Adr);	//find or add the loco, replace the oldest if full
+	void removeSlot(byte slot);
+	void setPending(byte slot, uint16_t bits);	//mark changed and add to the ring
+	byte sendChanged(byte *packet);
+	byte sendRefresh(byte *packet);
+	byte encode(byte *packet, byte slot, byte part);
+};
+
+#endif
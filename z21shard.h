@@ -0,0 +1,539 @@
+/*
+  z21shard.h - protocol engine with threads for a Linux daemon (many clients and locos)
+  Copyright (c) 2026 Philipp Gahtow  All right reserved.
+
+  Notice:
+	- only on Linux, include after z21impl.h, build with -pthread
+	- the I/O thread call receive() for each datagram, the messages are routed by the address:
+		loco		LAN_X_SET_LOCO, LAN_X_GET_LOCO_INFO, LAN_X_SET_LOCO_BINARY_STATE, LAN_X_CV_POM (0x30)
+		accessory	LAN_X_SET_TURNOUT, LAN_X_GET_TURNOUT_INFO, LAN_X_SET_EXT_ACCESSORY, LAN_X_GET_EXT_ACCESSORY_INFO,
+					LAN_X_CV_POM (0x31)
+	  to the shard Adr % shards, all other messages to shard 0 (power, CV, RBus, LocoNet, system state)
+	- each shard is a thread with an own z21Base (client table, Z21STATE of its addresses),
+	  a queue from the I/O thread and a queue to the sender (one producer, one consumer, lock free)
+	- LAN_SET_BROADCASTFLAGS, LAN_LOGOFF and the WLANmaus 0x73 (BC-Flags) go to all shards, only shard 0 answer;
+	  a new endpoint and each z21ShardTouch ms an active endpoint is announced to all shards (client alive)
+	- the sender thread merge the frames for the same endpoint into one datagram (max. z21TXBufferSize)
+	  and call send(ip, port, data, len), ip = 0: to all clients (like client 0 of notifyz21EthSend)
+	- the hooks of the Handler run inside the shard threads, an address always inside the same shard,
+	  current() is the z21Base of the shard inside a hook, setPower() from any thread,
+	  post() a function to a shard (only from the I/O thread)
+	- not inside the shards: Capture, EthSendDatagram, EthReady, Persist; ClientHash only shard 0
+	- the z21Base store one loco for each client, a client subscribe one loco in each shard
+	- benchmark: extras/z21load with -s
+*/
+
+#ifndef z21shard_h
+#define z21shard_h
+
+#if defined(__linux__)
+
+#include <pthread.h>
+#include <sched.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define z21ShardMAX 16			//max. Threads (Shards)
+#define z21ShardQueue 1024		//messages from the I/O thread to each shard (2^n)
+#define z21ShardOutQueue 4096	//frames of each shard to the sender (2^n)
+#define z21ShardData 32			//max. Byte of a message to a shard (LocoNet: 24)
+#define z21ShardFrame 64		//max. Byte of a frame to the sender
+#define z21ShardTouch 10000		//ms, announce an active endpoint again to all shards
+#define z21ShardEndpointMAX 1024	//endpoints inside the I/O thread (2^n)
+#define z21ShardWait 10			//ms sleep of an idle thread, then tick()
+
+//kind of a message to a shard:
+#define z21ShardMsg		0	//receive()
+#define z21ShardMute	1	//receive() without answer (copy for the other shards)
+#define z21ShardAlive	2	//client alive
+#define z21ShardPost	3	//call the function
+
+static inline long z21ShardFutex(uint32_t *addr, int op, uint32_t value, long ms) {
+	struct timespec t;
+	t.tv_sec = ms / 1000;
+	t.tv_nsec = (ms % 1000) * 1000000L;
+	return syscall(SYS_futex, addr, op, value, ms > 0 ? &t : NULL, NULL, 0);
+}
+
+//--------------------------------------------------------------------------------------------
+//queue with one producer and one consumer, the consumer sleep on "head"
+template <class T, unsigned int N>
+struct z21ShardRing {
+	T item[N];
+	uint32_t head;		//next write, only the producer
+	byte pad[64];		//head and tail not in the same cache line
+	uint32_t tail;		//next read, only the consumer
+	uint32_t sleep;		//consumer wait
+
+	z21ShardRing() : head(0), tail(0), sleep(0) {}
+
+	T *back() {		//free entry or NULL if full
+		uint32_t h = head;
+		if (h - z21AtomicLoad(tail) >= N)
+			return NULL;
+		return &item[h & (N - 1)];
+	}
+	void push() {	//publish the entry of back()
+		z21AtomicStore(head, head + 1);
+		z21AtomicFence();
+		if (z21AtomicLoad(sleep) && __atomic_exchange_n(&sleep, 0, __ATOMIC_ACQ_REL))	//one wake until it sleep again
+			z21ShardFutex(&head, FUTEX_WAKE, INT_MAX, 0);
+	}
+	uint32_t count() {	//entries to read
+		return z21AtomicLoad(head) - tail;
+	}
+	T *at(uint32_t i) { return &item[(tail + i) & (N - 1)]; }
+	void pop(uint32_t n) {	//free the read entries
+		z21AtomicStore(tail, tail + n);
+	}
+	void wait(long ms) {	//until the next entry or the timeout
+		uint32_t h = tail;
+		z21AtomicStore(sleep, (uint32_t) 1);
+		z21AtomicFence();	//the producer see "sleep" or we see "head"
+		if (z21AtomicLoad(head) == h)
+			z21ShardFutex(&head, FUTEX_WAIT, h, ms);
+		z21AtomicStore(sleep, (uint32_t) 0);
+	}
+	bool empty() { return z21AtomicLoad(tail) == z21AtomicLoad(head); }
+};
+
+template <class Handler> class z21ShardEngine;
+
+//--------------------------------------------------------------------------------------------
+//Handler of the z21Base inside a shard: the hooks of the sketch, but send to the sender thread
+template <class Handler>
+struct z21ShardLink : Handler {
+	static void EthSend(uint8_t client, uint8_t *data);
+	static inline bool hasEthSendDatagram() { return false; }
+	static inline void EthSendDatagram(uint8_t client, uint8_t *data, uint16_t length) {}
+	static inline void Capture(uint8_t dir, uint8_t client, uint8_t *data) {}
+	static inline bool hasEthReady() { return false; }
+	static inline bool EthReady(uint8_t client) { return true; }
+	static inline bool hasPersist() { return false; }
+	static bool hasClientHash();
+	static void RailPower(uint8_t State);
+};
+
+//--------------------------------------------------------------------------------------------
+template <class Handler>
+class z21ShardEngine
+{
+  // user-accessible "public" interface
+  public:
+	typedef z21Base<z21ShardLink<Handler> > Base;
+	typedef void (*PostFn)(Base &z21, const byte *data);
+	typedef void (*SendFn)(uint32_t ip, uint16_t port, const uint8_t *data, uint16_t len);
+
+	z21ShardEngine(byte shards, SendFn send);	//start the threads
+	~z21ShardEngine();		//stop the threads
+
+	void receive(uint32_t ip, uint16_t port, const uint8_t *packet, uint16_t len);	//I/O thread: one datagram
+	void post(byte shard, PostFn fn, const byte *data, byte len);	//I/O thread: call fn inside the shard
+	void setPower(byte state);	//any thread: power to all shards
+	void flush();		//I/O thread: wait until all messages are sent
+	byte getShards() { return Shards; }
+	byte shardOf(uint16_t Adr) { return Adr % Shards; }
+	unsigned long getDropped() { return z21AtomicLoad(Dropped); }	//frames bigger than z21ShardFrame
+	static Base &current() { return Current->z21; }	//inside a hook: z21Base of the shard
+
+  // library-accessible "private" interface
+  private:
+	friend struct z21ShardLink<Handler>;
+
+	struct TypeZ21ShardIn {
+		uint32_t ip;
+		uint16_t port;
+		byte kind;		//z21ShardMsg...
+		byte len;
+		PostFn fn;
+		byte data[z21ShardData];
+	};
+	struct TypeZ21ShardOut {
+		uint32_t ip;	//0 = all
+		uint16_t port;
+		uint16_t len;
+		byte data[z21ShardFrame];
+	};
+	struct TypeZ21ShardEndpoint {
+		uint32_t ip;
+		uint16_t port;		//0 = unused
+		unsigned long touch;	//millis() of the last announce
+	};
+	struct Shard {
+		z21ShardEngine *engine;
+		byte index;
+		bool mute;		//no frames to the sender
+		unsigned long ticked;	//millis() of the last tick()
+		uint32_t power;	//last PowerSeq
+		pthread_t thread;
+		Base z21;
+		z21ShardRing<TypeZ21ShardIn, z21ShardQueue> in;
+		z21ShardRing<TypeZ21ShardOut, z21ShardOutQueue> out;
+	};
+
+	static thread_local Shard *Current;
+
+	Shard *Shard_[z21ShardMAX];
+	byte Shards;
+	SendFn Send;
+	pthread_t Sender;
+	uint32_t Stop;
+	byte Power;			//last setPower()
+	uint32_t PowerSeq;	//counter of setPower()
+	uint32_t SendWake;	//sender sleep on this word
+	uint32_t SendSleep;
+	unsigned long Dropped;
+	TypeZ21ShardEndpoint Endpoint[z21ShardEndpointMAX];
+	unsigned int EndpointCount;
+
+	byte route(const uint8_t *msg, bool &all);	//shard of the message
+	TypeZ21ShardEndpoint *announce(uint32_t ip, uint16_t port);	//new or alive endpoint to all shards
+	TypeZ21ShardIn *slot(byte shard);	//free entry of the queue, wait if full
+	void frame(Shard *s, uint32_t ip, uint16_t port, const uint8_t *data, uint16_t len);	//to the sender
+	void applyPower(Shard *s);
+	static void *shardMain(void *arg);
+	static void *senderMain(void *arg);
+};
+
+template <class Handler>
+thread_local typename z21ShardEngine<Handler>::Shard *z21ShardEngine<Handler>::Current = NULL;
+
+// Constructor /////////////////////////////////////////////////////////////////
+
+template <class Handler>
+z21ShardEngine<Handler>::z21ShardEngine(byte shards, SendFn send)
+{
+	Shards = (shards < 1) ? 1 : (shards > z21ShardMAX) ? z21ShardMAX : shards;
+	Send = send;
+	Stop = 0;
+	Power = csNormal;
+	PowerSeq = 0;
+	SendWake = 0;
+	SendSleep = 0;
+	Dropped = 0;
+	memset(Endpoint, 0, sizeof(Endpoint));
+	EndpointCount = 0;
+	for (byte i = 0; i < Shards; i++) {
+		Shard *s = new Shard;
+		s->engine = this;
+		s->index = i;
+		s->mute = false;
+		s->ticked = 0;
+		s->power = 0;
+		Shard_[i] = s;
+	}
+	for (byte i = 0; i < Shards; i++)
+		pthread_create(&Shard_[i]->thread, NULL, shardMain, Shard_[i]);
+	pthread_create(&Sender, NULL, senderMain, this);
+}
+
+template <class Handler>
+z21ShardEngine<Handler>::~z21ShardEngine()
+{
+	z21AtomicStore(Stop, (uint32_t) 1);
+	for (byte i = 0; i < Shards; i++) {
+		z21ShardFutex(&Shard_[i]->in.head, FUTEX_WAKE, INT_MAX, 0);
+		pthread_join(Shard_[i]->thread, NULL);
+	}
+	z21ShardFutex(&SendWake, FUTEX_WAKE, INT_MAX, 0);
+	pthread_join(Sender, NULL);
+	for (byte i = 0; i < Shards; i++)
+		delete Shard_[i];
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------------------------
+//split the datagram into the messages, route each message to its shard
+template <class Handler>
+void z21ShardEngine<Handler>::receive(uint32_t ip, uint16_t port, const uint8_t *packet, uint16_t len) {
+	TypeZ21ShardEndpoint *ep = announce(ip, port);
+	while (len >= 4) {
+		uint16_t msglen = word(packet[1], packet[0]);
+		if (msglen < 4 || msglen > len || msglen > z21ShardData)
+			return;		//broken or too long
+		bool all;
+		byte shard = route(packet, all);
+		if (word(packet[3], packet[2]) == LAN_LOGOFF)
+			ep->touch = millis() - z21ShardTouch;	//announce again with the next message
+		for (byte i = 0; i < Shards; i++) {
+			if (i != shard && !all)
+				continue;
+			TypeZ21ShardIn *m = slot(i);
+			m->ip = ip;
+			m->port = port;
+			m->kind = (i == shard) ? z21ShardMsg : z21ShardMute;
+			m->len = msglen;
+			memcpy(m->data, packet, msglen);
+			Shard_[i]->in.push();
+		}
+		packet += msglen;
+		len -= msglen;
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//messages of the command station (S88, LocoNet, system state...) inside the thread of the shard
+template <class Handler>
+void z21ShardEngine<Handler>::post(byte shard, PostFn fn, const byte *data, byte len) {
+	if (shard >= Shards || len > z21ShardData)
+		return;
+	TypeZ21ShardIn *m = slot(shard);
+	m->kind = z21ShardPost;
+	m->fn = fn;
+	m->len = len;
+	memcpy(m->data, data, len);
+	Shard_[shard]->in.push();
+}
+
+//--------------------------------------------------------------------------------------------
+//shard 0 inform the clients, the other shards only store the state
+template <class Handler>
+void z21ShardEngine<Handler>::setPower(byte state) {
+	z21AtomicStore(Power, state);
+	z21AtomicFetchAdd(PowerSeq, 1);
+	z21AtomicFence();
+	if (Current != NULL && Current->engine == this)
+		applyPower(Current);	//inside a hook: now
+	for (byte i = 0; i < Shards; i++)
+		z21ShardFutex(&Shard_[i]->in.head, FUTEX_WAKE, INT_MAX, 0);
+}
+
+//--------------------------------------------------------------------------------------------
+template <class Handler>
+void z21ShardEngine<Handler>::flush() {
+	for (byte i = 0; i < Shards; i++) {
+		while (!Shard_[i]->in.empty())
+			sched_yield();
+	}
+	for (byte i = 0; i < Shards; i++) {
+		while (!Shard_[i]->out.empty())
+			sched_yield();
+	}
+}
+
+// Private Methods ///////////////////////////////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------------------------
+//loco and accessory commands by address, BC-Flags and logoff to all
+template <class Handler>
+byte z21ShardEngine<Handler>::route(const uint8_t *msg, bool &all) {
+	uint16_t header = word(msg[3], msg[2]);
+	all = (header == LAN_SET_BROADCASTFLAGS || header == LAN_LOGOFF);
+	if (header != LAN_X_Header || word(msg[1], msg[0]) < 8)
+		return 0;
+	switch (msg[4]) {	//X-Header
+		case 0x73:		//WLANmaus: BC-Flags for all shards
+			all = true;
+			break;
+		case LAN_X_SET_LOCO:
+		case LAN_X_GET_LOCO_INFO:
+		case LAN_X_SET_LOCO_BINARY_STATE:
+			return shardOf(word(msg[6] & 0x3F, msg[7]));
+		case LAN_X_SET_TURNOUT:
+		case LAN_X_GET_TURNOUT_INFO:
+		case LAN_X_SET_EXT_ACCESSORY:
+		case LAN_X_GET_EXT_ACCESSORY_INFO:
+			return shardOf(word(msg[5], msg[6]));
+		case LAN_X_CV_POM:
+			if (msg[5] == 0x30)
+				return shardOf(word(msg[6] & 0x3F, msg[7]));
+			if (msg[5] == 0x31)
+				return shardOf(word(msg[6] & 0x1F, msg[7]));
+			break;
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------------------------------
+//a new endpoint and each z21ShardTouch ms to all shards, so no shard remove the client
+template <class Handler>
+typename z21ShardEngine<Handler>::TypeZ21ShardEndpoint *z21ShardEngine<Handler>::announce(uint32_t ip, uint16_t port) {
+	uint32_t h = (ip ^ ((uint32_t) port << 16) ^ port) * 2654435761UL;
+	h = (h >> 16) & (z21ShardEndpointMAX - 1);
+	while (Endpoint[h].port != 0 && (Endpoint[h].ip != ip || Endpoint[h].port != port))
+		h = (h + 1) & (z21ShardEndpointMAX - 1);
+	if (Endpoint[h].port != 0 && millis() - Endpoint[h].touch < z21ShardTouch)
+		return &Endpoint[h];
+	if (Endpoint[h].port == 0) {
+		if (EndpointCount >= z21ShardEndpointMAX * 3 / 4) {	//full: all endpoints again
+			memset(Endpoint, 0, sizeof(Endpoint));
+			EndpointCount = 0;
+			return announce(ip, port);
+		}
+		Endpoint[h].ip = ip;
+		Endpoint[h].port = port;
+		EndpointCount++;
+	}
+	Endpoint[h].touch = millis();
+	for (byte i = 0; i < Shards; i++) {
+		TypeZ21ShardIn *m = slot(i);
+		m->ip = ip;
+		m->port = port;
+		m->kind = z21ShardAlive;
+		m->len = 0;
+		Shard_[i]->in.push();
+	}
+	return &Endpoint[h];
+}
+
+//--------------------------------------------------------------------------------------------
+template <class Handler>
+typename z21ShardEngine<Handler>::TypeZ21ShardIn *z21ShardEngine<Handler>::slot(byte shard) {
+	TypeZ21ShardIn *m;
+	while ((m = Shard_[shard]->in.back()) == NULL)
+		sched_yield();		//shard is busy
+	return m;
+}
+
+//--------------------------------------------------------------------------------------------
+template <class Handler>
+void z21ShardEngine<Handler>::frame(Shard *s, uint32_t ip, uint16_t port, const uint8_t *data, uint16_t len) {
+	if (len > z21ShardFrame) {
+		z21AtomicFetchAdd(Dropped, 1);
+		return;
+	}
+	TypeZ21ShardOut *f;
+	while ((f = s->out.back()) == NULL)
+		sched_yield();		//sender is busy
+	f->ip = ip;
+	f->port = port;
+	f->len = len;
+	memcpy(f->data, data, len);
+	z21AtomicStore(s->out.head, s->out.head + 1);
+	z21AtomicFence();
+	if (z21AtomicLoad(SendSleep) && __atomic_exchange_n(&SendSleep, 0, __ATOMIC_ACQ_REL)) {
+		z21AtomicFetchAdd(SendWake, 1);
+		z21ShardFutex(&SendWake, FUTEX_WAKE, 1, 0);
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+template <class Handler>
+void z21ShardEngine<Handler>::applyPower(Shard *s) {
+	uint32_t seq = z21AtomicLoad(PowerSeq);
+	if (s->power == seq)
+		return;
+	s->power = seq;
+	bool mute = s->mute;
+	s->mute = mute || (s->index != 0);	//only shard 0 inform the clients
+	s->z21.setPower(z21AtomicLoad(Power));
+	s->mute = mute;
+}
+
+//--------------------------------------------------------------------------------------------
+//thread of a shard
+template <class Handler>
+void *z21ShardEngine<Handler>::shardMain(void *arg) {
+	Shard *s = (Shard*) arg;
+	Current = s;
+	z21ShardEngine *e = s->engine;
+	const byte alive[] = {0x04, 0x00, LAN_GET_BROADCASTFLAGS, 0x00};
+	while (!z21AtomicLoad(e->Stop)) {
+		e->applyPower(s);
+		if (millis() != s->ticked) {	//also while busy: timeouts of the clients
+			s->ticked = millis();
+			s->z21.tick();
+		}
+		uint32_t n = s->in.count();
+		if (n == 0) {
+			s->in.wait(z21ShardWait);
+			continue;
+		}
+		for (uint32_t i = 0; i < n; i++) {
+			TypeZ21ShardIn *m = s->in.at(i);
+			if (m->kind == z21ShardPost) {
+				m->fn(s->z21, m->data);
+				continue;
+			}
+			s->mute = (m->kind == z21ShardMute) || (m->kind == z21ShardAlive && s->index != 0);
+			byte client = s->z21.getClient(m->ip, m->port);		//new client: snapshot only from shard 0
+			if (client > 0) {
+				s->mute |= (m->kind == z21ShardAlive);
+				s->z21.receive(client, m->kind == z21ShardAlive ? (uint8_t*) alive : m->data);	//time of the client
+			}
+			s->mute = false;
+		}
+		s->in.pop(n);
+	}
+	return NULL;
+}
+
+//--------------------------------------------------------------------------------------------
+//thread of the sender: frames of all shards, one datagram for the frames to the same endpoint
+template <class Handler>
+void *z21ShardEngine<Handler>::senderMain(void *arg) {
+	z21ShardEngine *e = (z21ShardEngine*) arg;
+	uint8_t buf[z21TXBufferSize];
+	while (true) {
+		bool idle = true;
+		for (byte i = 0; i < e->Shards; i++) {
+			z21ShardRing<TypeZ21ShardOut, z21ShardOutQueue> &out = e->Shard_[i]->out;
+			uint32_t n = out.count();
+			if (n == 0)
+				continue;
+			idle = false;
+			uint16_t len = 0;
+			uint32_t ip = 0;
+			uint16_t port = 0;
+			for (uint32_t j = 0; j < n; j++) {
+				TypeZ21ShardOut *f = out.at(j);
+				if (len > 0 && (f->ip != ip || f->port != port || len + f->len > z21TXBufferSize)) {
+					e->Send(ip, port, buf, len);
+					len = 0;
+				}
+				ip = f->ip;
+				port = f->port;
+				memcpy(buf + len, f->data, f->len);
+				len += f->len;
+			}
+			if (len > 0)
+				e->Send(ip, port, buf, len);
+			out.pop(n);
+		}
+		if (!idle)
+			continue;
+		if (z21AtomicLoad(e->Stop))
+			return NULL;
+		uint32_t wake = z21AtomicLoad(e->SendWake);
+		z21AtomicStore(e->SendSleep, (uint32_t) 1);
+		z21AtomicFence();	//a shard see "SendSleep" or we see the frame
+		bool empty = true;
+		for (byte i = 0; i < e->Shards; i++)
+			empty &= (e->Shard_[i]->out.count() == 0);
+		if (empty)
+			z21ShardFutex(&e->SendWake, FUTEX_WAIT, wake, z21ShardWait);
+		z21AtomicStore(e->SendSleep, (uint32_t) 0);
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+//Handler inside the shard:
+template <class Handler>
+void z21ShardLink<Handler>::EthSend(uint8_t client, uint8_t *data) {
+	typename z21ShardEngine<Handler>::Shard *s = z21ShardEngine<Handler>::Current;
+	if (s->mute)
+		return;
+	uint32_t ip = 0;
+	uint16_t port = 0;
+	if (client > 0 && !s->z21.getEndpoint(client, ip, port))
+		return;		//client is gone
+	s->engine->frame(s, ip, port, data, word(data[1], data[0]));
+}
+
+template <class Handler>
+bool z21ShardLink<Handler>::hasClientHash() {
+	return z21ShardEngine<Handler>::Current->index == 0 && Handler::hasClientHash();	//one writer of the EEPROM
+}
+
+template <class Handler>
+void z21ShardLink<Handler>::RailPower(uint8_t State) {
+	if (!z21ShardEngine<Handler>::Current->mute)	//not for a copy of LAN_SET_BROADCASTFLAGS
+		Handler::RailPower(State);
+}
+
+#endif
+
+#endif
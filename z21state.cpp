@@ -0,0 +1,297 @@
+/*
+*****************************************************************************
+  *		z21state.cpp - state of the command station (power, locos, turnouts)
+  *		Copyright (c) 2026 Philipp Gahtow  All right reserved.
+  *
+  *
+*****************************************************************************
+  * IMPORTANT:
+  *
+  * 	Please contact ROCO Inc. for more details.
+*****************************************************************************
+*/
+
+// include this library's description file
+#include <z21.h>
+
+// Constructor /////////////////////////////////////////////////////////////////
+// Function that handles the creation and setup of instances
+
+z21StateClass::z21StateClass()
+{
+	Railpower = csTrackVoltageOff;
+	LocoNext = 0;
+	FrontCount = 0;
+	memset(Loco, 0, sizeof(Loco));
+	memset(Trnt, 0, sizeof(Trnt));
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+// Functions available in Wiring sketches, this library, and other libraries
+
+//*********************************************************************************************
+//Writer:
+
+//--------------------------------------------------------------------------------------------
+//state of the railpower
+void z21StateClass::setPower(byte state) {
+	z21AtomicStore(Railpower, state);
+}
+
+//--------------------------------------------------------------------------------------------
+//full loco state (like notifyz21LocoState)
+void z21StateClass::setLoco(uint16_t Adr, byte *data) {
+	if (Adr == 0)
+		return;	//not a loco
+	byte slot = findLoco(Adr);
+	if (slot == z21StateLocoMAX) {
+		slot = LocoNext;
+		LocoNext = (LocoNext + 1) % z21StateLocoMAX;
+	}
+	writeLoco(slot, Adr, data);
+}
+
+//--------------------------------------------------------------------------------------------
+//speed and direction (RVVV VVVV) of the loco
+void z21StateClass::setLocoSpeed(uint16_t Adr, byte speed, byte steps) {
+	byte data[6] = {DCCSTEP128, 0, 0, 0, 0, 0};
+	getLoco(Adr, data);	//only writer, no wait
+	locoSpeed(data, speed, steps);
+	setLoco(Adr, data);
+}
+
+//--------------------------------------------------------------------------------------------
+//single function F0 - F28 of the loco
+void z21StateClass::setLocoFkt(uint16_t Adr, byte type, byte fkt) {
+	byte data[6] = {DCCSTEP128, 0, 0, 0, 0, 0};
+	getLoco(Adr, data);
+	if (locoFkt(data, type, fkt))
+		setLoco(Adr, data);
+}
+
+//--------------------------------------------------------------------------------------------
+//function group of the loco (DB0 of LAN_X_SET_LOCO_FUNCTION_GROUP)
+void z21StateClass::setLocoFktGroup(uint16_t Adr, byte group, byte fkt) {
+	byte data[6] = {DCCSTEP128, 0, 0, 0, 0, 0};
+	getLoco(Adr, data);
+	if (locoFktGroup(data, group, fkt))
+		setLoco(Adr, data);
+}
+
+//--------------------------------------------------------------------------------------------
+//speed and steps into the loco data
+void z21StateClass::locoSpeed(byte *data, byte speed, byte steps) {
+	if (steps == 14)
+		data[0] = DCCSTEP14;
+	else if (steps == 28)
+		data[0] = DCCSTEP28;
+	else data[0] = DCCSTEP128;
+	data[1] = speed;
+}
+
+//--------------------------------------------------------------------------------------------
+//single function F0 - F28 into the loco data
+bool z21StateClass::locoFkt(byte *data, byte type, byte fkt) {
+	byte pos;	//Byte and Bit inside data
+	byte bit;
+	if (fkt == 0) {
+		pos = 2;
+		bit = 4;
+	}
+	else if (fkt <= 4) {
+		pos = 2;
+		bit = fkt - 1;
+	}
+	else if (fkt <= 28) {
+		pos = 3 + ((fkt - 5) >> 3);
+		bit = (fkt - 5) & 0x07;
+	}
+	else return false;	//not stored
+	if (type == 0)
+		bitClear(data[pos], bit);
+	else if (type == 1)
+		bitSet(data[pos], bit);
+	else data[pos] ^= (1 << bit);	//toggle
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------
+//function group into the loco data
+bool z21StateClass::locoFktGroup(byte *data, byte group, byte fkt) {
+	switch (group) {
+		case 0x20: data[2] = (data[2] & 0xE0) | (fkt & 0x1F); break;	//0 0 0 F0 F4 F3 F2 F1
+		case 0x21: data[3] = (data[3] & 0xF0) | (fkt & 0x0F); break;	//0 0 0 0 F8 F7 F6 F5
+		case 0x22: data[3] = (data[3] & 0x0F) | (fkt << 4); break;		//0 0 0 0 F12 F11 F10 F9
+		case 0x23: data[4] = fkt; break;	//F20 F19 F18 F17 F16 F15 F14 F13
+		case 0x28: data[5] = fkt; break;	//F28 F27 F26 F25 F24 F23 F22 F21
+		default: return false;	//not stored
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------
+//LAN_X_SET_LOCO (drive, function, function group) into the loco data
+bool z21StateClass::locoCommand(byte *data, byte db0, byte db3) {
+	if ((db0 & 0xF0) == 0x10) {	//LAN_X_SET_LOCO_DRIVE
+		locoSpeed(data, db3, (db0 == 0x12) ? 28 : (db0 == 0x10) ? 14 : 128);
+		return true;
+	}
+	if (db0 == 0xF8)	//LAN_X_SET_LOCO_FUNCTION
+		return locoFkt(data, db3 >> 6, db3 & 0x3F);
+	return locoFktGroup(data, db0, db3);
+}
+
+//--------------------------------------------------------------------------------------------
+//position of the turnout
+void z21StateClass::setTrnt(uint16_t Adr, bool State) {
+	if (Adr >= z21StateTrntMAX)
+		return;
+	byte value = Trnt[Adr >> 3];
+	bitWrite(value, Adr & 0x07, State);
+	z21AtomicStore(Trnt[Adr >> 3], value);	//one byte, no sequence counter needed
+}
+
+//*********************************************************************************************
+//Reader:
+
+//--------------------------------------------------------------------------------------------
+byte z21StateClass::getPower() {
+	return z21AtomicLoad(Railpower);
+}
+
+//--------------------------------------------------------------------------------------------
+//consistent copy of the loco state, retry while the writer change the entry
+bool z21StateClass::getLoco(uint16_t Adr, byte *data) {
+	for (byte i = 0; i < z21StateLocoMAX; i++) {
+		if (z21AtomicLoad(Loco[i].adr) != Adr)
+			continue;	//no fence for the other entries
+		byte copy[6];
+		unsigned int seq;
+		bool found;
+		do {
+			seq = z21AtomicLoad(Loco[i].seq);
+			found = (Loco[i].adr == Adr) && (Adr != 0);
+			if (found)
+				memcpy(copy, Loco[i].data, 6);
+			z21AtomicFence();
+		} while ((seq & 0x01) || (seq != z21AtomicLoad(Loco[i].seq)));
+		if (found) {
+			memcpy(data, copy, 6);
+			return true;
+		}
+	}
+	return false;
+}
+
+//--------------------------------------------------------------------------------------------
+bool z21StateClass::getTrnt(uint16_t Adr) {
+	if (Adr >= z21StateTrntMAX)
+		return false;
+	return bitRead(z21AtomicLoad(Trnt[Adr >> 3]), Adr & 0x07);
+}
+
+//*********************************************************************************************
+//Front-Ends:
+
+//--------------------------------------------------------------------------------------------
+//add a Front-End that share this state
+bool z21StateClass::attach(z21StateListener *front) {
+	for (byte i = 0; i < FrontCount; i++) {
+		if (Front[i] == front)
+			return true;	//already attached
+	}
+	if (FrontCount >= z21StateFrontMAX)
+		return false;
+	Front[FrontCount++] = front;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------
+void z21StateClass::changedPower(z21StateListener *from, byte state) {
+	for (byte i = 0; i < FrontCount; i++) {
+		if (Front[i] != from)
+			Front[i]->statePower(state);
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+void z21StateClass::changedLoco(z21StateListener *from, uint16_t Adr) {
+	for (byte i = 0; i < FrontCount; i++) {
+		if (Front[i] != from)
+			Front[i]->stateLoco(Adr);
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+void z21StateClass::changedTrnt(z21StateListener *from, uint16_t Adr, bool State) {
+	for (byte i = 0; i < FrontCount; i++) {
+		if (Front[i] != from)
+			Front[i]->stateTrnt(Adr, State);
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+void z21StateClass::changedExtACC(z21StateListener *from, uint16_t Adr, byte State, byte Status) {
+	for (byte i = 0; i < FrontCount; i++) {
+		if (Front[i] != from)
+			Front[i]->stateExtACC(Adr, State, Status);
+	}
+}
+
+//--------------------------------------------------------------------------------------------
+void z21StateClass::changedS88(z21StateListener *from, byte *data) {
+	for (byte i = 0; i < FrontCount; i++) {
+		if (Front[i] != from)
+			Front[i]->stateS88(data);
+	}
+}
+
+//*********************************************************************************************
+//Snapshot:
+
+//--------------------------------------------------------------------------------------------
+//entry of the loco table by index, only for the writer
+bool z21StateClass::getLocoSlot(byte slot, uint16_t &Adr, byte *data) {
+	if (slot >= z21StateLocoMAX || Loco[slot].adr == 0)
+		return false;
+	Adr = Loco[slot].adr;
+	memcpy(data, Loco[slot].data, 6);
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------
+byte z21StateClass::getTrntByte(uint16_t pos) {
+	if (pos >= z21StateTrntMAX / 8)
+		return 0;
+	return Trnt[pos];
+}
+
+//--------------------------------------------------------------------------------------------
+void z21StateClass::setTrntByte(uint16_t pos, byte value) {
+	if (pos < z21StateTrntMAX / 8)
+		z21AtomicStore(Trnt[pos], value);
+}
+
+// Private Methods ///////////////////////////////////////////////////////////////////////////////////////////////////
+// Functions only available to other functions in this library *******************************************************
+
+//--------------------------------------------------------------------------------------------
+//entry of the loco, only for the writer
+byte z21StateClass::findLoco(uint16_t Adr) {
+	for (byte i = 0; i < z21StateLocoMAX; i++) {
+		if (Loco[i].adr == Adr)
+			return i;
+	}
+	return z21StateLocoMAX;
+}
+
+//--------------------------------------------------------------------------------------------
+//publish the entry: odd sequence while writing, reader retry
+void z21StateClass::writeLoco(byte slot, uint16_t Adr, byte *data) {
+	unsigned int seq = Loco[slot].seq;
+	z21AtomicStore(Loco[slot].seq, seq + 1);
+	z21AtomicFence();
+	Loco[slot].adr = Adr;
+	memcpy(Loco[slot].data, data, 6);
+	z21AtomicStore(Loco[slot].seq, seq + 2);
+}
@@ -0,0 +1,121 @@
+/*
+  z21state.h - state of the command station (power, locos, turnouts)
+  Copyright (c) 2026 Philipp Gahtow  All right reserved.
+
+  Notice:
+	- only one task write the state (the task that call z21Class::receive())
+	- other tasks or cores read a consistent snapshot without lock,
+	  each loco entry has a sequence counter (odd = writing)
+	- don't read from an interrupt, the reader wait while the writer is inside the entry
+	- more then one z21Class can share the state (attach), a change of one Front-End
+	  is send once to the clients of each other Front-End
+*/
+
+#ifndef z21state_h
+#define z21state_h
+
+// include types & constants of Wiring core API
+#if defined(WIRING)
+ #include <Wiring.h>
+#elif ARDUINO >= 100
+ #include <Arduino.h>
+#else
+ #include <WProgram.h>
+#endif
+
+//--------------------------------------------------------------
+//lock free access to indices that are shared with an other task or core:
+#if defined(__AVR__)	//single core, only keep the order of the compiler
+#define z21AtomicFence()		__asm__ __volatile__ ("" ::: "memory")
+#define z21AtomicLoad(v)		(v)
+#define z21AtomicStore(v, x)	do { z21AtomicFence(); (v) = (x); } while (0)
+#define z21AtomicFetchAdd(v, x)	(((v) += (x)) - (x))
+#else
+#define z21AtomicFence()		__atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define z21AtomicLoad(v)		__atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#define z21AtomicStore(v, x)	__atomic_store_n(&(v), (x), __ATOMIC_RELEASE)
+#define z21AtomicFetchAdd(v, x)	__atomic_fetch_add(&(v), (x), __ATOMIC_RELAXED)
+#endif
+
+//--------------------------------------------------------------
+#if defined(__AVR__)
+#define z21StateLocoMAX 8		//Anzahl gespeicherter Loks
+#define z21StateTrntMAX 256		//Anzahl gespeicherter Weichen (ab Adr 0, 8er Schritte)
+#else
+#define z21StateLocoMAX 64		//Anzahl gespeicherter Loks
+#define z21StateTrntMAX 2048	//Anzahl gespeicherter Weichen (ab Adr 0, 8er Schritte)
+#endif
+
+#define z21StateFrontMAX 4		//Anzahl z21Class (Front-Ends) an einem gemeinsamen Zustand
+
+struct TypeZ21LocoState {
+  unsigned int seq;	//sequence counter, odd while writing
+  uint16_t adr;		//0 = unused
+  byte data[6];		//like notifyz21LocoState: Steps[0], Speed[1], F0[2], F1[3], F2[4], F3[5]
+};
+
+//Front-End (z21Class) that get the changes of the other Front-Ends:
+class z21StateListener
+{
+  public:
+	virtual ~z21StateListener() {}
+	virtual void statePower(byte state) = 0;
+	virtual void stateLoco(uint16_t Adr) = 0;
+	virtual void stateTrnt(uint16_t Adr, bool State) = 0;
+	virtual void stateExtACC(uint16_t Adr, byte State, byte Status) = 0;
+	virtual void stateS88(byte *data) = 0;
+};
+
+// library interface description
+class z21StateClass
+{
+  // user-accessible "public" interface
+  public:
+	z21StateClass(void);	//Constuctor
+
+		//Writer (only one task):
+	void setPower(byte state);		//state of the railpower
+	void setLoco(uint16_t Adr, byte *data);	//full loco state, data[6] like notifyz21LocoState
+	void setLocoSpeed(uint16_t Adr, byte speed, byte steps);	//steps: 14, 28 or 128
+	void setLocoFkt(uint16_t Adr, byte type, byte fkt);	//type: 0 = off, 1 = on, 2 = toggle; fkt: F0 - F28
+	void setLocoFktGroup(uint16_t Adr, byte group, byte fkt);	//group: DB0 of LAN_X_SET_LOCO_FUNCTION_GROUP
+	void setTrnt(uint16_t Adr, bool State);	//position of the turnout
+
+		//change of loco data (data[6] like notifyz21LocoState) without the table, false if not stored:
+	static void locoSpeed(byte *data, byte speed, byte steps);
+	static bool locoFkt(byte *data, byte type, byte fkt);
+	static bool locoFktGroup(byte *data, byte group, byte fkt);
+	static bool locoCommand(byte *data, byte db0, byte db3);	//DB0 and DB3 of LAN_X_SET_LOCO
+
+		//Reader (any task):
+	byte getPower();
+	bool getLoco(uint16_t Adr, byte *data);	//false if the loco is unknown
+	bool getTrnt(uint16_t Adr);		//position of the turnout, false if unknown
+
+		//Front-Ends (only from the writer task):
+	bool attach(z21StateListener *front);	//add a Front-End, false if full
+	void changedPower(z21StateListener *from, byte state);	//inform all other Front-Ends
+	void changedLoco(z21StateListener *from, uint16_t Adr);
+	void changedTrnt(z21StateListener *from, uint16_t Adr, bool State);
+	void changedExtACC(z21StateListener *from, uint16_t Adr, byte State, byte Status);
+	void changedS88(z21StateListener *from, byte *data);
+
+		//Snapshot (only from the writer task):
+	bool getLocoSlot(byte slot, uint16_t &Adr, byte *data);	//entry of the table, false if unused
+	byte getTrntByte(uint16_t pos);		//turnouts pos*8 up to pos*8+7
+	void setTrntByte(uint16_t pos, byte value);
+
+  // library-accessible "private" interface
+  private:
+	byte Railpower;
+	TypeZ21LocoState Loco[z21StateLocoMAX];
+	byte LocoNext;		//next entry to replace
+	byte Trnt[z21StateTrntMAX / 8];	//one bit for each turnout
+	z21StateListener *Front[z21StateFrontMAX];	//attached Front-Ends
+	byte FrontCount;
+
+	byte findLoco(uint16_t Adr);	//entry of the loco, z21StateLocoMAX if unknown
+	void writeLoco(byte slot, uint16_t Adr, byte *data);	//publish the entry
+};
+
+#endif